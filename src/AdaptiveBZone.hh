@@ -0,0 +1,242 @@
+/*
+  Copyright (c) 2011 Timothy Lovorn
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#ifndef __SCSS_ADAPTIVE_BZONE_H
+#define __SCSS_ADAPTIVE_BZONE_H
+
+#include <cmath>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "BaseState.hh"
+#include "KGrid.hh"
+
+// Start from this many cells on a side.
+#define ADAPTIVE_INIT_CELLS 8
+// Split up to this many of the worst cells per round; their children are
+// evaluated in parallel.
+#define ADAPTIVE_BATCH_CELLS 16
+
+// Globally adaptive cubature over the Brillouin zone.  Each square cell gets
+// a 4x4 and a 3x3 Gauss-Legendre rule; the 4x4 result is kept and the 
+// difference is its error estimate.  The cell with the largest error is 
+// split in four until the errors add up to less than env.adaptiveTol for 
+// every average, so points pile up where the integrand is sharp (near the 
+// Fermi surface) instead of being spread evenly like BZone's grid.  An edge
+// which passes between all of a cell's points goes unseen, so the starting
+// cells shouldn't be much bigger than the features being integrated.
+//
+// Only KGRID_SYM_SIN is used from symmetry: with it, the zone is folded onto
+// [-pi/2, pi/2]^2.  Cells are split in a fixed order and summed in a fixed 
+// order, so results don't depend on env.numThreads.
+class AdaptiveBZone {
+public:
+    // Average numValues quantities, like BZone::averages.  If errors is not
+    // NULL it gets the estimated absolute error of each average.
+    template <class SpecializedState>
+    static AdaptiveResult averages(const BaseState& stBase, 
+        const SpecializedState& stSpec, 
+        void (*innerFunc)(const SpecializedState&, const KPoint&, double*),
+        int numValues, double *out, double *errors = NULL,
+        int symmetry = KGRID_SYM_NONE);
+private:
+    // Integrand evaluations per cell.
+    static const int evalsPerCell = 25;
+    struct Cell {
+        double x0, y0, h;
+        // Contribution to each average and its error estimate; error is
+        // the largest of errors.
+        std::vector<double> values, errors;
+        double error;
+    };
+    // Fill in cell's values and errors.  scale converts integrals over the
+    // cell to contributions to the averages.
+    template <class SpecializedState>
+    static void evaluate(const SpecializedState& stSpec, 
+        void (*innerFunc)(const SpecializedState&, const KPoint&, double*),
+        int numValues, double scale, Cell& cell);
+};
+
+template <class SpecializedState>
+void AdaptiveBZone::evaluate(const SpecializedState& stSpec, 
+        void (*innerFunc)(const SpecializedState&, const KPoint&, double*),
+        int numValues, double scale, Cell& cell) {
+    static const double node3[3] = {-0.77459666924148338, 0.0, 
+                                    0.77459666924148338};
+    static const double weight3[3] = {5.0 / 9.0, 8.0 / 9.0, 5.0 / 9.0};
+    static const double node4[4] = {-0.86113631159405258, 
+                                    -0.33998104358485626,
+                                    0.33998104358485626, 
+                                    0.86113631159405258};
+    static const double weight4[4] = {0.34785484513745386, 
+                                      0.65214515486254614,
+                                      0.65214515486254614, 
+                                      0.34785484513745386};
+    const double half = cell.h / 2.0, 
+                 cx = cell.x0 + half, cy = cell.y0 + half,
+                 cellScale = scale * half * half;
+    std::vector<double> terms(numValues), 
+                        gauss3(numValues, 0.0), gauss4(numValues, 0.0);
+    for (int j = 0; j < 4; j++) {
+        for (int i = 0; i < 4; i++) {
+            innerFunc(stSpec, KPoint(cx + half * node4[i], 
+                                     cy + half * node4[j]), &terms[0]);
+            for (int v = 0; v < numValues; v++) {
+                gauss4[v] += weight4[i] * weight4[j] * terms[v];
+            }
+        }
+    }
+    for (int j = 0; j < 3; j++) {
+        for (int i = 0; i < 3; i++) {
+            innerFunc(stSpec, KPoint(cx + half * node3[i], 
+                                     cy + half * node3[j]), &terms[0]);
+            for (int v = 0; v < numValues; v++) {
+                gauss3[v] += weight3[i] * weight3[j] * terms[v];
+            }
+        }
+    }
+    cell.values.resize(numValues);
+    cell.errors.resize(numValues);
+    cell.error = 0.0;
+    for (int v = 0; v < numValues; v++) {
+        cell.values[v] = cellScale * gauss4[v];
+        cell.errors[v] = cellScale * fabs(gauss4[v] - gauss3[v]);
+        if (cell.errors[v] > cell.error) {
+            cell.error = cell.errors[v];
+        }
+    }
+}
+
+template <class SpecializedState>
+AdaptiveResult AdaptiveBZone::averages(const BaseState& stBase, 
+        const SpecializedState& stSpec, 
+        void (*innerFunc)(const SpecializedState&, const KPoint&, double*),
+        int numValues, double *out, double *errors, int symmetry) {
+    const BaseEnvironment& env = stBase.env;
+    const double side = (symmetry & KGRID_SYM_SIN) ? M_PI : 2.0 * M_PI,
+                 scale = 1.0 / (side * side);
+    const int initCells = ADAPTIVE_INIT_CELLS;
+    std::vector<Cell> cells(initCells * initCells);
+    for (int iy = 0; iy < initCells; iy++) {
+        for (int ix = 0; ix < initCells; ix++) {
+            Cell& cell = cells[iy * initCells + ix];
+            cell.h = side / initCells;
+            cell.x0 = -side / 2.0 + ix * cell.h;
+            cell.y0 = -side / 2.0 + iy * cell.h;
+        }
+    }
+    #pragma omp parallel for num_threads(env.passThreads()) schedule(dynamic)
+    for (int c = 0; c < (int)cells.size(); c++) {
+        evaluate(stSpec, innerFunc, numValues, scale, cells[c]);
+    }
+    AdaptiveResult result;
+    result.evaluations = evalsPerCell * cells.size();
+    // Worst cell first; ties go to the higher index, which is still a 
+    // fixed order.
+    std::priority_queue<std::pair<double, int> > worst;
+    std::vector<double> totalErrors(numValues, 0.0);
+    for (int c = 0; c < (int)cells.size(); c++) {
+        worst.push(std::make_pair(cells[c].error, c));
+        for (int v = 0; v < numValues; v++) {
+            totalErrors[v] += cells[c].errors[v];
+        }
+    }
+    std::vector<int> parents;
+    std::vector<Cell> children;
+    while (true) {
+        double maxError = 0.0;
+        for (int v = 0; v < numValues; v++) {
+            if (totalErrors[v] > maxError) {
+                maxError = totalErrors[v];
+            }
+        }
+        if (maxError <= env.adaptiveTol) {
+            result.converged = true;
+            break;
+        }
+        const int affordable = (env.adaptiveMaxEvals - result.evaluations) 
+                               / (4 * evalsPerCell);
+        if (affordable < 1) {
+            break;
+        }
+        parents.clear();
+        while (!worst.empty() && (int)parents.size() < affordable
+               && (int)parents.size() < ADAPTIVE_BATCH_CELLS) {
+            parents.push_back(worst.top().second);
+            worst.pop();
+        }
+        children.assign(4 * parents.size(), Cell());
+        for (size_t p = 0; p < parents.size(); p++) {
+            const Cell& parent = cells[parents[p]];
+            for (int q = 0; q < 4; q++) {
+                Cell& child = children[4 * p + q];
+                child.h = parent.h / 2.0;
+                child.x0 = parent.x0 + (q % 2) * child.h;
+                child.y0 = parent.y0 + (q / 2) * child.h;
+            }
+        }
+        #pragma omp parallel for num_threads(env.passThreads()) \
+                                 schedule(dynamic)
+        for (int c = 0; c < (int)children.size(); c++) {
+            evaluate(stSpec, innerFunc, numValues, scale, children[c]);
+        }
+        result.evaluations += evalsPerCell * children.size();
+        // The first child takes its parent's place; the rest go on the end.
+        for (size_t p = 0; p < parents.size(); p++) {
+            for (int v = 0; v < numValues; v++) {
+                totalErrors[v] -= cells[parents[p]].errors[v];
+            }
+            for (int q = 0; q < 4; q++) {
+                const int index = q == 0 ? parents[p] : (int)cells.size();
+                if (q == 0) {
+                    cells[index] = children[4 * p];
+                } else {
+                    cells.push_back(children[4 * p + q]);
+                }
+                worst.push(std::make_pair(cells[index].error, index));
+                for (int v = 0; v < numValues; v++) {
+                    totalErrors[v] += cells[index].errors[v];
+                }
+            }
+        }
+    }
+    // Add up from scratch rather than trust the running totals.
+    result.error = 0.0;
+    for (int v = 0; v < numValues; v++) {
+        double sum = 0.0, error = 0.0;
+        for (size_t c = 0; c < cells.size(); c++) {
+            sum += cells[c].values[v];
+            error += cells[c].errors[v];
+        }
+        out[v] = sum;
+        if (errors != NULL) {
+            errors[v] = error;
+        }
+        if (error > result.error) {
+            result.error = error;
+        }
+    }
+    return result;
+}
+
+#endif
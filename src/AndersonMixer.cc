@@ -0,0 +1,166 @@
+/*
+  Copyright (c) 2011 Timothy Lovorn
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include "AndersonMixer.hh"
+
+AndersonMixer::AndersonMixer(int dim, int depth, 
+                             const std::vector<double>& weights) :
+    myDim(dim), myDepth(depth), myWeights(weights), steps(0), 
+    firstNorm(0.0), secondNorm(0.0), latestNorm(0.0)
+{ }
+
+std::vector<double> AndersonMixer::mix(const std::vector<double>& x, 
+                                       const std::vector<double>& g) {
+    std::vector<double> f(myDim);
+    for (int i = 0; i < myDim; i++) {
+        f[i] = g[i] - x[i];
+    }
+    latestNorm = weightedNorm(f);
+    if (steps == 0) {
+        firstNorm = latestNorm;
+    } else if (steps == 1) {
+        secondNorm = latestNorm;
+    }
+    if (!lastF.empty()) {
+        std::vector<double> df(myDim), dg(myDim);
+        for (int i = 0; i < myDim; i++) {
+            df[i] = f[i] - lastF[i];
+            dg[i] = g[i] - lastG[i];
+        }
+        dF.push_back(df);
+        dG.push_back(dg);
+        if ((int)dF.size() > myDepth) {
+            dF.erase(dF.begin());
+            dG.erase(dG.begin());
+        }
+    }
+    lastF = f;
+    lastG = g;
+    steps++;
+    const int m = dF.size();
+    if (m == 0 || latestNorm < 1.0) {
+        return g;
+    }
+    // Normal equations for the gamma minimizing |W (f - dF gamma)|,
+    // with a little Tikhonov damping in case the history is degenerate.
+    std::vector<std::vector<double> > A(m, std::vector<double>(m + 1));
+    double maxDiag = 0.0;
+    for (int i = 0; i < m; i++) {
+        for (int j = 0; j < m; j++) {
+            double sum = 0.0;
+            for (int k = 0; k < myDim; k++) {
+                sum += myWeights[k] * myWeights[k] * dF[i][k] * dF[j][k];
+            }
+            A[i][j] = sum;
+        }
+        double rhs = 0.0;
+        for (int k = 0; k < myDim; k++) {
+            rhs += myWeights[k] * myWeights[k] * dF[i][k] * f[k];
+        }
+        A[i][m] = rhs;
+        maxDiag = fmax(maxDiag, A[i][i]);
+    }
+    if (maxDiag == 0.0) {
+        reset();
+        return g;
+    }
+    for (int i = 0; i < m; i++) {
+        A[i][i] += 1e-10 * maxDiag;
+    }
+    // Gaussian elimination with partial pivoting.
+    for (int col = 0; col < m; col++) {
+        int pivot = col;
+        for (int row = col + 1; row < m; row++) {
+            if (fabs(A[row][col]) > fabs(A[pivot][col])) {
+                pivot = row;
+            }
+        }
+        A[col].swap(A[pivot]);
+        for (int row = col + 1; row < m; row++) {
+            double factor = A[row][col] / A[col][col];
+            for (int j = col; j <= m; j++) {
+                A[row][j] -= factor * A[col][j];
+            }
+        }
+    }
+    std::vector<double> gamma(m);
+    for (int i = m - 1; i >= 0; i--) {
+        double sum = A[i][m];
+        for (int j = i + 1; j < m; j++) {
+            sum -= A[i][j] * gamma[j];
+        }
+        gamma[i] = sum / A[i][i];
+    }
+    std::vector<double> next(g);
+    for (int i = 0; i < m; i++) {
+        for (int k = 0; k < myDim; k++) {
+            next[k] -= gamma[i] * dG[i][k];
+        }
+    }
+    for (int k = 0; k < myDim; k++) {
+        if (!std::isfinite(next[k])) {
+            reset();
+            return g;
+        }
+    }
+    return next;
+}
+
+void AndersonMixer::reset() {
+    dF.clear();
+    dG.clear();
+    lastF.clear();
+    lastG.clear();
+}
+
+int AndersonMixer::getSteps() const {
+    return steps;
+}
+
+int AndersonMixer::estimatePlainSteps() const {
+    if (steps < 2 || firstNorm <= 0.0 || latestNorm <= 0.0) {
+        return -1;
+    }
+    double rate = secondNorm / firstNorm;
+    if (rate <= 0.0 || rate >= 1.0) {
+        return -1;
+    }
+    // Plain iteration shrinks the residual by rate per step; count the
+    // final step from which the latest residual was measured.
+    return (int)ceil(log(latestNorm / firstNorm) / log(rate)) + 1;
+}
+
+double AndersonMixer::aitken(double x0, double x1, double x2) {
+    double denom = x2 - 2.0 * x1 + x0;
+    if (denom == 0.0) {
+        return x2;
+    }
+    return x0 - (x1 - x0) * (x1 - x0) / denom;
+}
+
+double AndersonMixer::weightedNorm(const std::vector<double>& f) const {
+    double sum = 0.0;
+    for (int i = 0; i < myDim; i++) {
+        sum += myWeights[i] * myWeights[i] * f[i] * f[i];
+    }
+    return sqrt(sum);
+}
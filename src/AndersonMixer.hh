@@ -0,0 +1,69 @@
+/*
+  Copyright (c) 2011 Timothy Lovorn
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#ifndef __SCSS_ANDERSON_MIXER_H
+#define __SCSS_ANDERSON_MIXER_H
+
+#include <cmath>
+#include <vector>
+
+// Anderson mixing (a.k.a. DIIS) for a fixed-point iteration x -> g(x).
+// The next iterate is the combination of the last few steps which 
+// minimizes the (weighted) residual g(x) - x in the least squares sense.
+class AndersonMixer {
+public:
+    // Mix vectors of length dim, remembering up to depth previous steps.
+    // Residual component i is multiplied by weights[i] before minimizing.
+    AndersonMixer(int dim, int depth, const std::vector<double>& weights);
+    // x is the current iterate and g the result of one plain step from x.
+    // Return the next iterate to use.  Once the weighted residual g - x is
+    // below 1 (with weights of 1/tolerance, inside the tolerances), g is
+    // returned as-is: differences that small are mostly noise from inexact
+    // inner solves, and mixing them only wanders.
+    std::vector<double> mix(const std::vector<double>& x, 
+                            const std::vector<double>& g);
+    // Forget history (e.g. after the mixed iterate had to be thrown out).
+    void reset();
+    // Number of calls to mix() so far.
+    int getSteps() const;
+    // Estimated number of plain steps it would have taken to shrink the 
+    // residual as much as it has been shrunk so far, assuming plain 
+    // iteration converges at the rate seen over the first step.  Returns -1
+    // if that isn't known or plain iteration looks like it doesn't converge.
+    int estimatePlainSteps() const;
+    // Aitken delta-squared extrapolation of x0, x1 = g(x0), x2 = g(x1).
+    // Returns x2 if the extrapolation is undefined.
+    static double aitken(double x0, double x1, double x2);
+private:
+    const int myDim, myDepth;
+    const std::vector<double> myWeights;
+    // Differences between successive residuals and successive g's.
+    std::vector<std::vector<double> > dF, dG;
+    // Residual and g from the previous step.
+    std::vector<double> lastF, lastG;
+    int steps;
+    // Weighted residual norms at the first two steps and the latest one.
+    double firstNorm, secondNorm, latestNorm;
+    double weightedNorm(const std::vector<double>& f) const;
+};
+
+#endif
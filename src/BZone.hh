@@ -25,63 +25,370 @@
 
 #include <cmath>
 #include <cfloat>
+#include <vector>
 
 #include "BaseState.hh"
 #include "ZeroTempState.hh"
+#include "KGrid.hh"
 
+// -- accumulators --
+// An accumulator collects values over grid points: add(func, k) takes in
+// point k (calling func however it needs to), combine() merges in another
+// accumulator's results.  Sums count each point k.weight times, so they come
+// out the same on symmetry-reduced grids.
+
+class BZoneSum {
+public:
+    BZoneSum() : sum(0.0) { }
+    template <class Func>
+    void add(const Func& func, const KPoint& k) {
+        sum += k.weight * func(k);
+    }
+    void combine(const BZoneSum& other) {
+        sum += other.sum;
+    }
+    double sum;
+};
+
+class BZoneMin {
+public:
+    BZoneMin() : min(DBL_MAX) { }
+    template <class Func>
+    void add(const Func& func, const KPoint& k) {
+        const double val = func(k);
+        if (val < min) {
+            min = val;
+        }
+    }
+    void combine(const BZoneMin& other) {
+        if (other.min < min) {
+            min = other.min;
+        }
+    }
+    double min;
+};
+
+class BZoneMax {
+public:
+    BZoneMax() : max(-DBL_MAX) { }
+    template <class Func>
+    void add(const Func& func, const KPoint& k) {
+        const double val = func(k);
+        if (val > max) {
+            max = val;
+        }
+    }
+    void combine(const BZoneMax& other) {
+        if (other.max > max) {
+            max = other.max;
+        }
+    }
+    double max;
+};
+
+// Sums numValues quantities; func(k, terms) writes the terms for point k.
+class BZoneMultiSum {
+public:
+    BZoneMultiSum(int numValues) : sums(numValues, 0.0), terms(numValues) { }
+    template <class Func>
+    void add(const Func& func, const KPoint& k) {
+        func(k, &terms[0]);
+        for (size_t i = 0; i < sums.size(); i++) {
+            sums[i] += k.weight * terms[i];
+        }
+    }
+    void combine(const BZoneMultiSum& other) {
+        for (size_t i = 0; i < sums.size(); i++) {
+            sums[i] += other.sums[i];
+        }
+    }
+    std::vector<double> sums;
+private:
+    std::vector<double> terms;  // scratch space for func
+};
+
+// -- point functions --
+// Bind a State to one of its Spectrum's functions so it can be called with
+// just a point.  Any other class with a matching operator() works as well;
+// one whose operator() is visible here gets inlined into the traversal.
+
+template <class SpecializedState>
+class BZonePointFunc {
+public:
+    BZonePointFunc(const SpecializedState& st, 
+        double (*func)(const SpecializedState&, const KPoint&)) :
+        myState(st), myFunc(func) { }
+    double operator()(const KPoint& k) const {
+        return myFunc(myState, k);
+    }
+private:
+    const SpecializedState& myState;
+    double (* const myFunc)(const SpecializedState&, const KPoint&);
+};
+
+template <class SpecializedState>
+class BZoneTermsFunc {
+public:
+    BZoneTermsFunc(const SpecializedState& st, 
+        void (*func)(const SpecializedState&, const KPoint&, double*)) :
+        myState(st), myFunc(func) { }
+    void operator()(const KPoint& k, double *terms) const {
+        myFunc(myState, k, terms);
+    }
+private:
+    const SpecializedState& myState;
+    void (* const myFunc)(const SpecializedState&, const KPoint&, double*);
+};
+
+template <class SpecializedState>
+class BZoneKxKyFunc {
+public:
+    BZoneKxKyFunc(const SpecializedState& st, 
+        double (*func)(const SpecializedState&, double, double)) :
+        myState(st), myFunc(func) { }
+    double operator()(const KPoint& k) const {
+        return myFunc(myState, k.kx, k.ky);
+    }
+private:
+    const SpecializedState& myState;
+    double (* const myFunc)(const SpecializedState&, double, double);
+};
+
+// The grid is traversed as gridLen rows of gridLen points.  Rows are split
+// among env.passThreads() threads, but each row is always accumulated on its
+// own and the row results are combined in row order afterward, so the 
+// result is bitwise identical for any number of threads.
+//
+// Every traversal takes the symmetries (KGRID_SYM_*) of the function being
+// summed; with any declared, only the reduced KGrid is visited.
 class BZone {
 public:
+    // Run acc over every point of the grid, starting each row from a copy
+    // of acc, and return the combined result.
+    template <class Accumulator, class Func>
+    static Accumulator traverse(const BaseState& stBase, const Func& func,
+                                const Accumulator& acc, 
+                                int symmetry = KGRID_SYM_NONE);
+
+    // innerFunc is given the precomputed point from the shared KGrid.
     template <class SpecializedState>
     static double average(const BaseState& stBase, 
         const SpecializedState& stSpec, 
-        double (*innerFunc)(const SpecializedState&, double, double));
+        double (*innerFunc)(const SpecializedState&, const KPoint&),
+        int symmetry = KGRID_SYM_NONE);
 
     template <class SpecializedState>
     static double minimum(const BaseState& stBase, 
         const SpecializedState& stSpec, 
-        double (*innerFunc)(const SpecializedState&, double, double));
+        double (*innerFunc)(const SpecializedState&, const KPoint&),
+        int symmetry = KGRID_SYM_NONE);
+
+    // Average numValues quantities in one pass.  innerFunc writes the terms
+    // for one point into its last argument; the averages are put in out.
+    template <class SpecializedState>
+    static void averages(const BaseState& stBase, 
+        const SpecializedState& stSpec, 
+        void (*innerFunc)(const SpecializedState&, const KPoint&, double*),
+        int numValues, double *out, int symmetry = KGRID_SYM_NONE);
+
+    // Like averages, but batchFunc handles a whole row at a time: it writes
+    // the weighted sums of its numValues terms over grid points 
+    // [begin, end) into its last argument.  Working straight from the KGrid
+    // arrays lets the compiler vectorize across points.
+    template <class SpecializedState>
+    static void averagesBatch(const BaseState& stBase, 
+        const SpecializedState& stSpec, 
+        void (*batchFunc)(const SpecializedState&, const KGrid&, int, int, 
+                          double*),
+        int numValues, double *out, int symmetry = KGRID_SYM_NONE);
+
+    // averagesBatch for many States at once, which must all sum over the 
+    // same grid.  Each row is run through batchFunc for every State while
+    // its sines and energies are still in cache.  Average i of states[s] 
+    // goes in out[s * numValues + i], bitwise the same as averagesBatch 
+    // would give for that State alone.
+    template <class SpecializedState>
+    static void averagesBatchMulti(
+        const std::vector<const SpecializedState*>& states,
+        void (*batchFunc)(const SpecializedState&, const KGrid&, int, int, 
+                          double*),
+        int numValues, double *out, int symmetry = KGRID_SYM_NONE);
+
+    // innerFunc is given bare (kx, ky).
+    template <class SpecializedState>
+    static double average(const BaseState& stBase, 
+        const SpecializedState& stSpec, 
+        double (*innerFunc)(const SpecializedState&, double, double),
+        int symmetry = KGRID_SYM_NONE);
+
+    template <class SpecializedState>
+    static double minimum(const BaseState& stBase, 
+        const SpecializedState& stSpec, 
+        double (*innerFunc)(const SpecializedState&, double, double),
+        int symmetry = KGRID_SYM_NONE);
+private:
+    // traverse over the rows of grid.  FixedLen is 0 for any grid; 
+    // otherwise grid must be the full grid with gridLen FixedLen, and the
+    // loop bounds are then known at compile time.
+    template <int FixedLen, class Accumulator, class Func>
+    static Accumulator traverseRows(const BaseState& stBase, 
+                                    const KGrid& grid, const Func& func, 
+                                    const Accumulator& acc);
 };
 
-// Would be nice to have a single function handle transforming one BZone point
-// into another instead of duplicating the traversal
-// OR just specify accumulator function (val = accum(val, thisPointVal))
+// The full grid of the common sizes gets its own copy of the traversal 
+// unless SCSS_NO_FIXED_GRID_LENS is defined.
+template <class Accumulator, class Func>
+Accumulator BZone::traverse(const BaseState& stBase, const Func& func,
+                            const Accumulator& acc, int symmetry) {
+    const KGrid& grid = KGrid::forGridLen(stBase.getGridLen(), symmetry);
+#ifndef SCSS_NO_FIXED_GRID_LENS
+    if (symmetry == KGRID_SYM_NONE) {
+        switch (grid.gridLen) {
+        case 64:
+            return traverseRows<64>(stBase, grid, func, acc);
+        case 128:
+            return traverseRows<128>(stBase, grid, func, acc);
+        case 256:
+            return traverseRows<256>(stBase, grid, func, acc);
+        case 512:
+            return traverseRows<512>(stBase, grid, func, acc);
+        }
+    }
+#endif
+    return traverseRows<0>(stBase, grid, func, acc);
+}
+
+template <int FixedLen, class Accumulator, class Func>
+Accumulator BZone::traverseRows(const BaseState& stBase, const KGrid& grid,
+                                const Func& func, const Accumulator& acc) {
+    const int numRows = FixedLen > 0 ? FixedLen : grid.numRows;
+    std::vector<Accumulator> rows(numRows, acc);
+    #pragma omp parallel for num_threads(stBase.env.passThreads()) \
+                             schedule(static)
+    for (int r = 0; r < numRows; r++) {
+        Accumulator& row = rows[r];
+        const int begin = FixedLen > 0 ? r * FixedLen : grid.rowStart[r],
+                  end = FixedLen > 0 ? (r + 1) * FixedLen 
+                                     : grid.rowStart[r + 1];
+        for (int k = begin; k < end; k++) {
+            row.add(func, KPoint(grid, k));
+        }
+    }
+    Accumulator result(acc);
+    for (int r = 0; r < numRows; r++) {
+        result.combine(rows[r]);
+    }
+    return result;
+}
+
 template <class SpecializedState>
 double BZone::minimum(const BaseState& stBase, 
         const SpecializedState& stSpec, 
-        double (*innerFunc)(const SpecializedState&, double, double)) {
-    double kx = -M_PI, ky = -M_PI, min = DBL_MAX, val;
-    int N = stBase.env.gridLen;
-    double step = 2 * M_PI / N;
-    while (ky < M_PI) {
-        while (kx < M_PI) {
-            val = innerFunc(stSpec, kx, ky);
-            if (val < min) {
-                min = val;
-            }      
-            kx += step;      
-        }
-        ky += step;
-        kx = -M_PI;
-    }
-    return min;
+        double (*innerFunc)(const SpecializedState&, const KPoint&),
+        int symmetry) {
+    return traverse(stBase, BZonePointFunc<SpecializedState>(stSpec, 
+                                                             innerFunc),
+                    BZoneMin(), symmetry).min;
 }
 
 template <class SpecializedState>
 double BZone::average(const BaseState& stBase, 
         const SpecializedState& stSpec, 
-        double (*innerFunc)(const SpecializedState&, double, double)) {
-    double kx = -M_PI, ky = -M_PI, min = DBL_MAX, sum = 0.0;
-    int N = stBase.env.gridLen;
-    double step = 2 * M_PI / N;
-    while (ky < M_PI) {
-        while (kx < M_PI) {
-            sum += innerFunc(stSpec, kx, ky);
-            kx += step;      
+        double (*innerFunc)(const SpecializedState&, const KPoint&),
+        int symmetry) {
+    const int N = stBase.getGridLen();
+    return traverse(stBase, BZonePointFunc<SpecializedState>(stSpec, 
+                                                             innerFunc),
+                    BZoneSum(), symmetry).sum / (N * N);
+}
+
+template <class SpecializedState>
+void BZone::averages(const BaseState& stBase, 
+        const SpecializedState& stSpec, 
+        void (*innerFunc)(const SpecializedState&, const KPoint&, double*),
+        int numValues, double *out, int symmetry) {
+    const int N = stBase.getGridLen();
+    const BZoneMultiSum total = traverse(stBase, 
+        BZoneTermsFunc<SpecializedState>(stSpec, innerFunc), 
+        BZoneMultiSum(numValues), symmetry);
+    for (int i = 0; i < numValues; i++) {
+        out[i] = total.sums[i] / (N * N);
+    }
+}
+
+template <class SpecializedState>
+void BZone::averagesBatch(const BaseState& stBase, 
+        const SpecializedState& stSpec, 
+        void (*batchFunc)(const SpecializedState&, const KGrid&, int, int, 
+                          double*),
+        int numValues, double *out, int symmetry) {
+    const int N = stBase.getGridLen();
+    const KGrid& grid = KGrid::forGridLen(N, symmetry);
+    std::vector<double> rowSums(grid.numRows * numValues, 0.0);
+    #pragma omp parallel for num_threads(stBase.env.passThreads()) \
+                             schedule(static)
+    for (int r = 0; r < grid.numRows; r++) {
+        batchFunc(stSpec, grid, grid.rowStart[r], grid.rowStart[r + 1], 
+                  &rowSums[r * numValues]);
+    }
+    for (int i = 0; i < numValues; i++) {
+        double sum = 0.0;
+        for (int r = 0; r < grid.numRows; r++) {
+            sum += rowSums[r * numValues + i];
+        }
+        out[i] = sum / (N * N);
+    }
+}
+
+template <class SpecializedState>
+void BZone::averagesBatchMulti(
+        const std::vector<const SpecializedState*>& states,
+        void (*batchFunc)(const SpecializedState&, const KGrid&, int, int, 
+                          double*),
+        int numValues, double *out, int symmetry) {
+    const BaseState& stBase = *states[0];
+    const int N = stBase.getGridLen(), numStates = states.size();
+    const KGrid& grid = KGrid::forGridLen(N, symmetry);
+    const int rowValues = numStates * numValues;
+    std::vector<double> rowSums(grid.numRows * rowValues, 0.0);
+    #pragma omp parallel for num_threads(stBase.env.passThreads()) \
+                             schedule(static)
+    for (int r = 0; r < grid.numRows; r++) {
+        for (int s = 0; s < numStates; s++) {
+            batchFunc(*states[s], grid, grid.rowStart[r], 
+                      grid.rowStart[r + 1], 
+                      &rowSums[r * rowValues + s * numValues]);
         }
-        ky += step;
-        kx = -M_PI;
     }
-    return sum / (N * N);
+    for (int i = 0; i < rowValues; i++) {
+        double sum = 0.0;
+        for (int r = 0; r < grid.numRows; r++) {
+            sum += rowSums[r * rowValues + i];
+        }
+        out[i] = sum / (N * N);
+    }
+}
+
+template <class SpecializedState>
+double BZone::minimum(const BaseState& stBase, 
+        const SpecializedState& stSpec, 
+        double (*innerFunc)(const SpecializedState&, double, double),
+        int symmetry) {
+    return traverse(stBase, BZoneKxKyFunc<SpecializedState>(stSpec, 
+                                                            innerFunc),
+                    BZoneMin(), symmetry).min;
+}
+
+template <class SpecializedState>
+double BZone::average(const BaseState& stBase, 
+        const SpecializedState& stSpec, 
+        double (*innerFunc)(const SpecializedState&, double, double),
+        int symmetry) {
+    const int N = stBase.getGridLen();
+    return traverse(stBase, BZoneKxKyFunc<SpecializedState>(stSpec, 
+                                                            innerFunc),
+                    BZoneSum(), symmetry).sum / (N * N);
 }
 
 #endif
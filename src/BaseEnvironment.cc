@@ -22,6 +22,10 @@
 
 #include "BaseEnvironment.hh"
 
+// The calling thread's share of numThreads, or 0 for all of them.
+static int threadShare = 0;
+#pragma omp threadprivate(threadShare)
+
 // Grab general data from cfg and build loggers.
 BaseEnvironment::BaseEnvironment(const ConfigData& cfg) :
     gridLen(cfg.getValue<int>("gridLen")),
@@ -34,7 +38,33 @@ BaseEnvironment::BaseEnvironment(const ConfigData& cfg) :
     initMu(cfg.getValue<double>("initMu")),
     tolD1(cfg.getValue<double>("tolD1")),
     tolMu(cfg.getValue<double>("tolMu")),
+    numThreads(cfg.getValue<int>("numThreads", 1)),
+    solverMode(cfg.getValue<std::string>("solverMode", "nested")),
+    mixingMode(cfg.getValue<std::string>("mixingMode", "none")),
+    andersonDepth(cfg.getValue<int>("andersonDepth", 3)),
+    epsilonMinMode(cfg.getValue<std::string>("epsilonMinMode", "analytic")),
+    kernelMode(cfg.getValue<std::string>("kernelMode", "batch")),
+    bzoneSymmetry(cfg.getValue<std::string>("bzoneSymmetry", "reduced")),
+    multigridLevels(cfg.getValue<int>("multigridLevels", 1)),
+    bracketGridLen(cfg.getValue<int>("bracketGridLen", 0)),
+    extrapolationLevels(cfg.getValue<int>("extrapolationLevels", 1)),
+    bzoneIntegrator(cfg.getValue<std::string>("bzoneIntegrator", "grid")),
+    adaptiveTol(cfg.getValue<double>("adaptiveTol", 1e-8)),
+    adaptiveMaxEvals(cfg.getValue<int>("adaptiveMaxEvals", 100000)),
+    precisionMode(cfg.getValue<std::string>("precisionMode", "double")),
     outputLog(cfg.getPath(), cfg.getValue<std::string>("outputLogName")),
     errorLog(cfg.getPath(), cfg.getValue<std::string>("errorLogName")),
     debugLog(cfg.getPath(), cfg.getValue<std::string>("debugLogName"))
 { }
+
+int BaseEnvironment::passThreads() const {
+    return threadShare > 0 ? threadShare : numThreads;
+}
+
+ThreadShare::ThreadShare(int threads) : previous(threadShare) {
+    threadShare = threads;
+}
+
+ThreadShare::~ThreadShare() {
+    threadShare = previous;
+}
@@ -23,6 +23,8 @@
 #ifndef __SCSS_BASE_ENVIRONMENT_H
 #define __SCSS_BASE_ENVIRONMENT_H
 
+#include <string>
+
 #include "ConfigData.hh"
 #include "Logger.hh"
 
@@ -43,6 +45,67 @@ public:
     const double initD1, initMu;
     // Tolerances.
     const double tolD1, tolMu;
+    // Number of threads used for Brillouin zone sums (optional, default 1).
+    const int numThreads;
+    // Threads for a Brillouin zone sum started on the calling thread: 
+    // numThreads, or that thread's share while it holds a ThreadShare.
+    int passThreads() const;
+    // Root-finding scheme (optional, default "nested"): "nested" solves one
+    // variable at a time with 1-D root finds inside each other; "coupled"
+    // solves for all variables at once, falling back to "nested" if that
+    // fails.
+    const std::string solverMode;
+    // Acceleration of the nested scheme's outer loop (optional, default 
+    // "none"): "anderson" mixes in the last andersonDepth (default 3) steps
+    // and uses Aitken extrapolation for scalar fixed-point updates.
+    const std::string mixingMode;
+    const int andersonDepth;
+    // How epsilonMin is found (optional, default "analytic"): "analytic" 
+    // uses the closed form; "validate" also takes the minimum over the grid
+    // and logs any disagreement to errorLog.
+    const std::string epsilonMinMode;
+    // How Brillouin zone sums for the S-C equations are evaluated (optional,
+    // default "batch"): "batch" uses the vectorized row kernels, "scalar"
+    // the one-point-at-a-time reference functions.
+    const std::string kernelMode;
+    // Brillouin zone points summed for the S-C equations (optional, default
+    // "reduced"): "reduced" visits one point per orbit of the terms' 
+    // symmetries, weighted by the orbit's size; "full" visits them all.
+    const std::string bzoneSymmetry;
+    // Coarse-to-fine solving (optional, both default off): solve first on 
+    // grids up to multigridLevels - 1 halvings coarser than gridLen, and 
+    // do root-finder bracket scans on a grid of side bracketGridLen.
+    const int multigridLevels, bracketGridLen;
+    // Richardson-extrapolate the S-C sums from gridLen and this many - 1
+    // halvings of it (optional, default 1 = plain sums at gridLen).  2 
+    // only estimates the error; extrapolating takes 3.
+    const int extrapolationLevels;
+    // How the S-C averages are integrated (optional, default "grid"): 
+    // "grid" sums over the gridLen x gridLen grid, "adaptive" subdivides
+    // cells where the integrand is hard until the estimated error is below
+    // adaptiveTol (default 1e-8) or adaptiveMaxEvals (default 100000)
+    // integrand evaluations have been spent.  "triangle" (zeroTemp only)
+    // interpolates linearly over triangles of the grid and integrates the
+    // occupations across each one exactly.
+    const std::string bzoneIntegrator;
+    const double adaptiveTol;
+    const int adaptiveMaxEvals;
+    // Precision of the batch kernels (optional, default "double"): 
+    // "mixed" starts each solve in single precision and switches to double
+    // once the errors are within MIXED_SWITCH_RATIO of their tolerances
+    // (or stop falling; see BaseState::updatePrecision).
+    const std::string precisionMode;
+};
+
+// While one exists, Brillouin zone sums started on the thread that made it
+// use threads threads.  For tasks that split numThreads between them and
+// run their sums side by side as nested parallel regions.
+class ThreadShare {
+public:
+    ThreadShare(int threads);
+    ~ThreadShare();
+private:
+    const int previous;
 };
 
 #endif
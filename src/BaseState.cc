@@ -20,12 +20,46 @@
   THE SOFTWARE.
 */
 
+#include <cfloat>
+#include <algorithm>
+#include <vector>
+
 #include "BaseState.hh"
+#include "Utility.hh"
 
 BaseState::BaseState(const BaseEnvironment& envIn) : 
-    env(envIn), d1(envIn.initD1), mu(envIn.initMu)
+    env(envIn), d1(envIn.initD1), mu(envIn.initMu), gridLen(envIn.gridLen),
+    outerIterations(0), outerIterationsSaved(0), 
+    outerMaxIters(OUTER_MAX_ITERS), lowPrecision(false), 
+    precisionSwitchIteration(0), floatSumError(0.0), lastScaledError(0.0)
 { }
 
+bool BaseState::makeSelfConsistent() {
+    // Coarsest level first.  Only grids which halve evenly are coarsened.
+    std::vector<int> levels(1, env.gridLen);
+    while ((int)levels.size() < env.multigridLevels && levels[0] % 2 == 0
+           && levels[0] / 2 >= MG_MIN_GRID_LEN) {
+        levels.insert(levels.begin(), levels[0] / 2);
+    }
+    bool converged = false;
+    for (size_t i = 0; i < levels.size(); i++) {
+        gridLen = levels[i];
+        outerMaxIters = i + 1 < levels.size() ? MG_COARSE_MAX_ITERS 
+                                              : OUTER_MAX_ITERS;
+        setEpsilonMin();
+        const double startTime = Utility::wallTime();
+        converged = solve();
+        env.debugLog.printf("gridLen %d solve %s in %f s\n", gridLen,
+                            converged ? "converged" : "failed",
+                            Utility::wallTime() - startTime);
+        if (!converged && i + 1 < levels.size()) {
+            env.errorLog.printf("Solve at coarse gridLen %d failed, going on "
+                                "to the next level anyway.\n", gridLen);
+        }
+    }
+    return converged;
+}
+
 // checkers
 bool BaseState::checkD1() const {
     return fabs(absErrorD1()) < env.tolD1;
@@ -47,3 +81,191 @@ double BaseState::getMu() const {
 double BaseState::getEpsilonMin() const {
     return epsilonMin;
 }
+
+int BaseState::getGridLen() const {
+    return gridLen;
+}
+
+double BaseState::coarseBracketHelper(double x, void *params) {
+    CoarseBracket *coarse = (CoarseBracket*)params;
+    BaseState *st = coarse->st;
+    const int savedGridLen = st->gridLen;
+    st->gridLen = st->env.bracketGridLen;
+    const double value = coarse->helper(x, coarse->params);
+    st->gridLen = savedGridLen;
+    return value;
+}
+
+void BaseState::setCoarseBracket(RootFinder& rootFinder, 
+                                 CoarseBracket& coarse) const {
+    if (env.bracketGridLen > 0 && env.bracketGridLen < gridLen) {
+        rootFinder.setBracketHelper(&BaseState::coarseBracketHelper, &coarse);
+    }
+}
+
+// With A(N) = A + c N^-p, A(N) - A(N/2) shrinks by 2^p per doubling.  Three
+// grids give 2^p directly; if they don't look like they're converging that 
+// way (at least first order), leave the sums alone and report the last 
+// difference as the error.  A ratio above 2^RICHARDSON_MAX_ORDER means 
+// exponential convergence, and the plain sum is kept.  Two grids can't 
+// tell an order apart from the exponential convergence of smooth periodic
+// sums, where assuming one would move an already-converged sum by far 
+// more than its error, so they only bound the error.
+void BaseState::extrapolateTerms(void (*termsAt)(const BaseState&, double*),
+                                 int numTerms, double *terms, 
+                                 double *discError) const {
+    std::vector<int> levels(1, gridLen);
+    while ((int)levels.size() < env.extrapolationLevels 
+           && levels.back() % 2 == 0 
+           && levels.back() / 2 >= MG_MIN_GRID_LEN) {
+        levels.push_back(levels.back() / 2);
+    }
+    termsAt(*this, terms);
+    if (levels.size() == 1) {
+        if (discError != NULL) {
+            for (int i = 0; i < numTerms; i++) {
+                discError[i] = 0.0;
+            }
+        }
+        return;
+    }
+    const int fineLen = gridLen;
+    std::vector<std::vector<double> > coarse(levels.size() - 1,
+                                             std::vector<double>(numTerms));
+    for (size_t level = 1; level < levels.size(); level++) {
+        gridLen = levels[level];
+        termsAt(*this, &coarse[level - 1][0]);
+    }
+    gridLen = fineLen;
+    for (int i = 0; i < numTerms; i++) {
+        const double diff = terms[i] - coarse[0][i];
+        double ratio = 0.0;
+        if (levels.size() > 2 && diff != 0.0) {
+            ratio = (coarse[0][i] - coarse[1][i]) / diff;
+        }
+        double error = fabs(diff);
+        if (ratio >= 2.0 && ratio <= pow(2.0, RICHARDSON_MAX_ORDER)) {
+            terms[i] += diff / (ratio - 1.0);
+            error = fabs(diff / (ratio - 1.0));
+        } else if (ratio > pow(2.0, RICHARDSON_MAX_ORDER)) {
+            // Faster than any power: the differences only keep shrinking
+            // faster, so diff / (ratio - 1) bounds the error of the plain
+            // sum, which would be made worse by extrapolating.
+            error = fabs(diff / (ratio - 1.0));
+        }
+        if (discError != NULL) {
+            discError[i] = error;
+        }
+    }
+}
+
+// variable manipulators
+double BaseState::setEpsilonMin() {
+    epsilonMin = analyticEpsilonMin();
+    if (env.epsilonMinMode == "validate") {
+        const double gridMin = gridEpsilonMin();
+        if (fabs(epsilonMin - gridMin) > 1e-12 * (1.0 + fabs(gridMin))) {
+            env.errorLog.printf("epsilonMin disagreement at d1 = %e: "
+                                "analytic %.15e, grid %.15e\n", d1, 
+                                epsilonMin, gridMin);
+        }
+    }
+    return epsilonMin;
+}
+
+void BaseState::startPrecision() {
+    lowPrecision = env.precisionMode == "mixed" && plainBatchSums();
+    precisionSwitchIteration = 0;
+    floatSumError = 0.0;
+    lastScaledError = DBL_MAX;
+}
+
+void BaseState::updatePrecision(double maxScaledError, 
+                                void (*termsAt)(const BaseState&, double*),
+                                int numTerms) {
+    if (!lowPrecision) {
+        return;
+    }
+    // Below MIXED_SWITCH_RATIO is the usual way out; the other two catch
+    // tolerances too tight for the float sums to ever reach it.
+    const char *reason = NULL;
+    if (maxScaledError < MIXED_SWITCH_RATIO) {
+        reason = "errors near tolerance";
+    } else if (maxScaledError >= lastScaledError) {
+        reason = "errors stopped falling";
+    } else if (outerIterations >= MIXED_MAX_FLOAT_ITERS) {
+        reason = "iteration cap";
+    }
+    lastScaledError = maxScaledError;
+    if (reason == NULL) {
+        return;
+    }
+    std::vector<double> single(numTerms), full(numTerms);
+    termsAt(*this, &single[0]);
+    lowPrecision = false;
+    termsAt(*this, &full[0]);
+    for (int i = 0; i < numTerms; i++) {
+        floatSumError = std::max(floatSumError, fabs(single[i] - full[i]));
+    }
+    precisionSwitchIteration = outerIterations;
+    env.debugLog.printf("switched to double precision after %d outer "
+                        "iterations (%s: max scaled error %e, float sums "
+                        "off by %e)\n", outerIterations, reason, 
+                        maxScaledError, floatSumError);
+}
+
+void BaseState::noteAdaptive(const AdaptiveResult& result) const {
+    adaptiveResult = result;
+    if (!result.converged) {
+        env.errorLog.printf("Adaptive BZone averages not converged: error "
+                            "estimate %e after %d evaluations\n", 
+                            result.error, result.evaluations);
+    }
+}
+
+void BaseState::logAdaptive() const {
+    env.outputLog.printf("adaptiveError,%e\nadaptiveEvaluations,%d\n"
+                         "adaptiveConverged,%s\n", adaptiveResult.error, 
+                         adaptiveResult.evaluations, 
+                         adaptiveResult.converged ? "true" : "false");
+}
+
+bool BaseState::separateSums() const {
+    return env.kernelMode == "scalar" && env.extrapolationLevels <= 1
+           && env.bzoneIntegrator == "grid";
+}
+
+bool BaseState::plainBatchSums() const {
+    return env.kernelMode == "batch" && env.extrapolationLevels <= 1
+           && env.bzoneIntegrator == "grid";
+}
+
+bool BaseState::batchScaledErrors(const std::vector<const BaseState*>& states,
+                                  double *errors) const {
+    return false;
+}
+
+// Every S-C term (and epsilonBar) depends on k only through epsA, epsB and
+// squares of sin kx +/- sin ky.  Those are unchanged by inversion and by 
+// exchange, and trivially by pi - k on either axis, which keeps the sines.
+int BaseState::termSymmetry() const {
+    if (env.bzoneSymmetry == "full") {
+        return KGRID_SYM_NONE;
+    }
+    return KGRID_SYM_ALL;
+}
+
+// epsilonBar = 2 th ((sx + sy)^2 - 1) + 4 c sx sy with c = d1 t0 - thp and
+// (sx, sy) = (sin kx, sin ky) ranging over the square [-1, 1]^2.
+// With s = (sx + sy) / 2, d = (sx - sy) / 2 this is 
+//     A s^2 + B d^2 - 2 th,  A = 8 th + 4 c,  B = -4 c
+// over the diamond |s| + |d| <= 1.  Along each edge of the diamond the
+// quadratic can only have an interior minimum if A and B are both positive,
+// in which case the origin is lower.  So the minimum is at the origin or
+// one of the corners: -2 th + min(0, A, B).  All of these points are on
+// the grid when gridLen is a multiple of 4.
+double BaseState::analyticEpsilonMin() const {
+    const double c = d1 * env.t0 - env.thp;
+    const double A = 8.0 * env.th + 4.0 * c, B = -4.0 * c;
+    return -2.0 * env.th + fmin(0.0, fmin(A, B));
+}
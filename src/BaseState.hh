@@ -25,8 +25,39 @@
 
 #include <cmath>
 #include <iostream>
+#include <vector>
 
 #include "BaseEnvironment.hh"
+#include "KGrid.hh"
+#include "RootFinder.hh"
+
+// Give up on the nested scheme after this many outer iterations.
+#define OUTER_MAX_ITERS 100
+// Coarse-to-fine solves don't go below this gridLen.
+#define MG_MIN_GRID_LEN 8
+// Coarse levels only supply a starting point, so cut them off early.
+#define MG_COARSE_MAX_ITERS 10
+// With precisionMode "mixed", the batch kernels switch from single to double
+// precision once every |error| / tolerance is below this.
+#define MIXED_SWITCH_RATIO 100.0
+// Float rounding can keep the errors above MIXED_SWITCH_RATIO for tight
+// tolerances, so switch anyway once they stop falling or after this many
+// outer iterations.
+#define MIXED_MAX_FLOAT_ITERS 10
+// Richardson extrapolation is only applied for measured convergence orders
+// in 1 / gridLen between 1 and this; faster means exponential convergence.
+#define RICHARDSON_MAX_ORDER 4
+
+// What an adaptive integration achieved, besides the averages themselves.
+struct AdaptiveResult {
+    AdaptiveResult() : error(0.0), evaluations(0), converged(false) { }
+    // Largest estimated absolute error among the averages.
+    double error;
+    // Integrand calls made.
+    int evaluations;
+    // False if env.adaptiveMaxEvals ran out before env.adaptiveTol was met.
+    bool converged;
+};
 
 class BaseState {
 public:
@@ -34,7 +65,9 @@ public:
     BaseState(const BaseEnvironment& envIn);
     // Drive calculations needed to make this State consistent
     // with the given Environment.  Return false if unable to converge.
-    virtual bool makeSelfConsistent() = 0;
+    // With env.multigridLevels > 1, solve on grids coarsened by factors of
+    // 2 first, starting each finer level from the last one's solution.
+    virtual bool makeSelfConsistent();
     // Return true is the errors in all self-consistent equations are within
     // their tolerances, false otherwise.
     virtual bool checkSelfConsistent() const = 0;
@@ -52,8 +85,24 @@ public:
     double getD1() const;
     double getMu() const;
     double getEpsilonMin() const;
+    // Side length of the grid BZone sums over right now.
+    int getGridLen() const;
     // Output what state is now.
     virtual void logState() const = 0;
+    // -- lockstep solving of many States (see SweepSolver) --
+    // Number of S-C variables, which is also the number of equations.
+    virtual int numVariables() const = 0;
+    // Copy the S-C variables out or in; setVariables also fixes epsilonMin.
+    virtual void getVariables(double *vars) const = 0;
+    virtual void setVariables(const double *vars) = 0;
+    // Errors in the S-C equations of each of states, divided by their 
+    // tolerances, so a State is self-consistent when all of its are below 1
+    // in magnitude.  Equation i of states[s] goes in 
+    // errors[s * numVariables() + i].  The sums for all of states are done
+    // in one traversal of the grid.  Return false if that can't be done: 
+    // states must all be of this State's class and sum over the same grid.
+    virtual bool batchScaledErrors(const std::vector<const BaseState*>& states,
+                                   double *errors) const;
     // RootFinder needs to be a friend to do its dirty work.
     friend class RootFinder;
     // Our Environment, containing all the configuration info we need.
@@ -61,18 +110,97 @@ public:
 protected:
     // Self-consistent variables.
     double d1, mu;
+    // Grid side length for BZone sums: env.gridLen, except on the coarse 
+    // levels of makeSelfConsistent, in coarse bracket scans and while 
+    // extrapolating (which happens inside const evaluations).
+    mutable int gridLen;
     // Minimum of Spectrum::epsilonBar() on the BZone.
     // The correct value for this depends on env and d1.
     double epsilonMin;
+    // Outer iterations taken by the nested scheme in the last call to
+    // makeSelfConsistent, and an estimate of how many of those mixing saved.
+    int outerIterations, outerIterationsSaved;
+    // Cap on outer iterations for the current solve() call.
+    int outerMaxIters;
+    // True while the batch kernels run in single precision.
+    bool lowPrecision;
+    // Outer iteration of the last solve() after which the kernels went 
+    // from single to double precision (0 if they were never single), and
+    // the largest difference between single and double sums right then.
+    int precisionSwitchIteration;
+    double floatSumError;
+    // Largest |error| / tolerance after the previous single-precision
+    // outer iteration.
+    double lastScaledError;
+    // The last adaptive averageTerms' outcome, for logState.
+    mutable AdaptiveResult adaptiveResult;
+    // Keep result as adaptiveResult, logging to errorLog if it fell short
+    // of env.adaptiveTol.
+    void noteAdaptive(const AdaptiveResult& result) const;
+    // Print adaptiveResult to outputLog.
+    void logAdaptive() const;
+    // Start a solve() in single precision if env.precisionMode is "mixed".
+    void startPrecision();
+    // Call after each outer iteration in single precision with the largest
+    // |error| / tolerance.  Switches to double precision once that's below
+    // MIXED_SWITCH_RATIO, stops falling, or MIXED_MAX_FLOAT_ITERS outer 
+    // iterations have passed, comparing numTerms sums from termsAt in both
+    // precisions.
+    void updatePrecision(double maxScaledError, 
+                         void (*termsAt)(const BaseState&, double*),
+                         int numTerms);
     // Set epsilonMin to the appropriate value.
     // -- Need to call this after changing D1! --
-    virtual double setEpsilonMin() = 0;
+    double setEpsilonMin();
+    // Minimum of epsilonBar over the whole Brillouin zone, in closed form.
+    double analyticEpsilonMin() const;
+    // Minimum of epsilonBar over the grid points (for validation).
+    virtual double gridEpsilonMin() const = 0;
+    // True if the S-C sums are best taken one at a time: scalar kernels on
+    // the plain grid, where averageTerms has no work to share among them.
+    bool separateSums() const;
+    // True if averageTerms is one plain BZone::averagesBatch pass (batch
+    // kernels on the plain grid), so it can be batched over States.
+    bool plainBatchSums() const;
+    // Symmetries (KGRID_SYM_*) to use for the S-C sums, per 
+    // env.bzoneSymmetry.
+    virtual int termSymmetry() const;
     // Set the variable to the value which minimizes the error in the
     // associated self-consistent equation. Return value found.
     // Note: d1 and mu equations are coupled, so they must be iterated 
     // together to find a pair of values that satisfies both equations.
     virtual bool fixD1() = 0;
     virtual bool fixMu() = 0;
+    // Solve the S-C equations at the current gridLen.
+    virtual bool solve() = 0;
+    // A RootFinder helper to evaluate on the env.bracketGridLen grid.
+    class CoarseBracket {
+    public:
+        CoarseBracket(BaseState *_st, double (*_helper)(double, void*), 
+                      void *_params) :
+            st(_st), helper(_helper), params(_params) { }
+        BaseState *st;
+        double (*helper)(double, void*);
+        void *params;
+    };
+    // Calls coarse->helper on the coarse grid (params is a CoarseBracket).
+    static double coarseBracketHelper(double x, void *params);
+    // If env.bracketGridLen is set and coarser than gridLen, have 
+    // rootFinder do its bracket scan with coarse.  coarse must outlive 
+    // rootFinder.
+    void setCoarseBracket(RootFinder& rootFinder, 
+                          CoarseBracket& coarse) const;
+    // Fill terms with numTerms BZone averages from termsAt, which sums on 
+    // st's current gridLen.  With env.extrapolationLevels > 2 the averages
+    // are Richardson-extrapolated from gridLen and two halvings if they 
+    // converge algebraically, and 
+    // discError (if not NULL) gets the size of each correction, i.e. the 
+    // estimated discretization error of the plain gridLen sums.  With only
+    // two grids the gridLen sums are kept and discError gets their 
+    // difference from the coarse ones, a bound on the error.
+    void extrapolateTerms(void (*termsAt)(const BaseState&, double*),
+                          int numTerms, double *terms, 
+                          double *discError) const;
 };
 
 #endif
@@ -59,6 +59,10 @@ public:
     // get named value from the map
     template <class DataType>
     DataType getValue(const std::string& key) const;
+    // get named value from the map, or defaultValue if it isn't there
+    template <class DataType>
+    DataType getValue(const std::string& key, 
+                      const DataType& defaultValue) const;
     // put a value into the map
     template <class DataType>
     void setValue(const std::string& key, const DataType& value);
@@ -93,6 +97,16 @@ DataType ConfigData::getValue(const std::string& key) const {
     return boost::lexical_cast<DataType>(it->second);
 }
 
+template <class DataType>
+DataType ConfigData::getValue(const std::string& key, 
+                              const DataType& defaultValue) const {
+    StringMap::iterator it = cfgMap->find(key);
+    if (it == cfgMap->end()) {
+        return defaultValue;
+    }
+    return boost::lexical_cast<DataType>(it->second);
+}
+
 template <class DataType>
 void ConfigData::setValue(const std::string& key, const DataType& value) {
     const std::string& strValue = boost::lexical_cast<std::string>(value);
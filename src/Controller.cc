@@ -21,6 +21,7 @@
 */
 
 #include "Controller.hh"
+#include "SweepSolver.hh"
 
 Controller::Controller(const ConfigData& config, 
                        const BaseEnvironment& env, BaseState& st) : 
@@ -59,6 +60,15 @@ bool Controller::selfConsistentCalc() {
     return myState.makeSelfConsistent();
 }
 
+bool Controller::sweepCalc(const std::vector<Controller*>& controls) {
+    std::vector<BaseState*> states;
+    for (size_t i = 0; i < controls.size(); i++) {
+        states.push_back(&controls[i]->myState);
+    }
+    SweepSolver solver(states);
+    return solver.solve();
+}
+
 void Controller::logState() {
     myState.logState();
 }
@@ -24,6 +24,7 @@
 #define __SCSS_CONTROLLER_H
 
 #include <string>
+#include <vector>
 
 #include "ConfigData.hh"
 #include "BaseState.hh"
@@ -48,6 +49,10 @@ public:
     ~Controller();
     // Do the self-consistent calculation.  Return false if can't converge.
     bool selfConsistentCalc();
+    // Do the self-consistent calculations of all of controls together,
+    // advancing related States in lockstep (see SweepSolver).  Return 
+    // false if any can't converge.
+    static bool sweepCalc(const std::vector<Controller*>& controls);
     // Output important data about current State.
     void logState();
     // Output configuration data.
@@ -26,5 +26,9 @@
 CritTempEnvironment::CritTempEnvironment(const ConfigData& cfg) :
     BaseEnvironment(cfg),
     initBc(cfg.getValue<double>("initBc")),
-    tolBc(cfg.getValue<double>("tolBc"))
+    tolBc(cfg.getValue<double>("tolBc")),
+    omegaRootMode(cfg.getValue<std::string>("omegaRootMode", "direct")),
+    omegaCoeffsMode(cfg.getValue<std::string>("omegaCoeffsMode", "exact")),
+    nuCacheTol(cfg.getValue<double>("nuCacheTol", 0.0)),
+    nuIntegralMode(cfg.getValue<std::string>("nuIntegralMode", "series"))
 { }
@@ -35,6 +35,25 @@ public:
     const double initBc;
     // Tolerances.
     const double tolBc;
+    // How omegaExact finds the root of Lambda (optional, default "direct"):
+    // "direct" evaluates Pi with a grid pass for every trial omega, 
+    // "table" root-finds on an interpolant of Pi(omega) built from one
+    // pass and checks the root exactly; "newton" uses Newton's method with
+    // dLambda/domega from the same pass as Lambda.
+    const std::string omegaRootMode;
+    // How getNu's omega coefficients are found (optional, default 
+    // "exact"): "exact" root-solves Lambda at a small k in three 
+    // directions, "expansion" expands Lambda about k = 0 in one grid pass,
+    // and "validate" does both, logging disagreements to the error log.
+    const std::string omegaCoeffsMode;
+    // CritTempState reuses nu while d1, mu and bc have moved less than 
+    // nuCacheTol times their tolerances (optional, default 0: only when 
+    // they haven't moved at all).
+    const double nuCacheTol;
+    // How getNu's Bose integral is done (optional, default "series"):
+    // "series" sums its closed-form expansions, "integrator" uses GSL's 
+    // adaptive quadrature as a reference.
+    const std::string nuIntegralMode;
 };
 
 #endif
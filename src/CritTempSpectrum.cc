@@ -20,6 +20,9 @@
   THE SOFTWARE.
 */
 
+#include <algorithm>
+#include <omp.h>
+
 #include "CritTempSpectrum.hh"
 
 LambdaInput::LambdaInput(const CritTempState& _st, double _kx, double _ky,
@@ -28,27 +31,51 @@ LambdaInput::LambdaInput(const CritTempState& _st, double _kx, double _ky,
 
 InnerPiInput::InnerPiInput(const CritTempState& _st, double _omega, 
                            double _kx, double _ky) :
-    st(_st), omega(_omega), kx(_kx), ky(_ky) { }
+    st(_st), omega(_omega), kx(_kx), ky(_ky),
+    cosHalfX(cos(_kx / 2)), sinHalfX(sin(_kx / 2)), 
+    cosHalfY(cos(_ky / 2)), sinHalfY(sin(_ky / 2)) { }
+
+InnerPiNodesInput::InnerPiNodesInput(const CritTempState& _st, 
+                                     const std::vector<double>& _omegas,
+                                     double _kx, double _ky) :
+    InnerPiInput(_st, 0.0, _kx, _ky), omegas(_omegas) { }
+
+// Interpolate through the Chebyshev nodes of [0, omegaMax].
+PiTable::PiTable(const LambdaInput& _lin, double _omegaMax) :
+    lin(_lin), omegaMax(_omegaMax), coeffs(3 * OMEGA_TABLE_NODES, 0.0)
+{
+    const int M = OMEGA_TABLE_NODES;
+    std::vector<double> omegas(M), pi(3 * M);
+    for (int j = 0; j < M; j++) {
+        omegas[j] = omegaMax * (1.0 + cos(M_PI * (j + 0.5) / M)) / 2.0;
+    }
+    CritTempSpectrum::getPiNodes(lin.st, omegas, lin.kx, lin.ky, &pi[0]);
+    for (int n = 0; n < M; n++) {
+        for (int j = 0; j < M; j++) {
+            const double basis = 2.0 * cos(M_PI * n * (j + 0.5) / M) / M;
+            for (int c = 0; c < 3; c++) {
+                coeffs[3 * n + c] += basis * pi[3 * j + c];
+            }
+        }
+    }
+}
 
 PiOutput::PiOutput(double _xx, double _xy, double _yy) :
     xx(_xx), xy(_xy), yy(_yy) { }
 
-double CritTempSpectrum::epsilon(const CritTempState& st, double kx, 
-                                 double ky) {
-    return epsilonBar(st, kx, ky) - st.getEpsilonMin();
+double CritTempSpectrum::epsilon(const CritTempState& st, const KPoint& k) {
+    return epsilonBar(st, k) - st.getEpsilonMin();
 }
 
-double CritTempSpectrum::epsilonBar(const CritTempState& st, double kx, 
-                                    double ky) {
+double CritTempSpectrum::epsilonBar(const CritTempState& st, 
+                                    const KPoint& k) {
     const CritTempEnvironment& env = st.env;
-    const double sx = sin(kx);
-    const double sy = sin(ky);
-    return 2.0 * env.th * ((sx + sy) * (sx + sy) - 1.0)
-         + 4.0 * (st.getD1() * env.t0 - env.thp) * sx * sy;
+    return 2.0 * env.th * k.epsA
+         + 4.0 * (st.getD1() * env.t0 - env.thp) * k.epsB;
 }
 
-double CritTempSpectrum::xi(const CritTempState& st, double kx, double ky) {
-    return epsilon(st, kx, ky) - st.getMu();
+double CritTempSpectrum::xi(const CritTempState& st, const KPoint& k) {
+    return epsilon(st, k) - st.getMu();
 }
 
 double CritTempSpectrum::fermi(const CritTempState& st, double energy) {
@@ -59,49 +86,259 @@ double CritTempSpectrum::bose(const CritTempState& st, double energy) {
     return 1.0 / (exp(st.getBc() * energy) - 1.0);
 }
 
-double CritTempSpectrum::innerX1(const CritTempState& st, double kx, 
-                                 double ky) {
-    return fermi(st, xi(st, kx, ky));
+double CritTempSpectrum::innerX1(const CritTempState& st, const KPoint& k) {
+    return fermi(st, xi(st, k));
+}
+
+double CritTempSpectrum::innerD1(const CritTempState& st, const KPoint& k) {
+    return -k.epsB * fermi(st, xi(st, k));
+}
+
+double CritTempSpectrum::innerMu(const CritTempState& st, const KPoint& k) {
+    const double sin_part = k.sinX - k.sinY;
+    const double xi_k = xi(st, k);
+    return sin_part * sin_part * tanh(st.getBc() * xi_k / 2.0) / xi_k;
 }
 
-double CritTempSpectrum::innerD1(const CritTempState& st, double kx, 
-                                 double ky) {
-    return -sin(kx) * sin(ky) * fermi(st, xi(st, kx, ky));
+void CritTempSpectrum::innerAll(const CritTempState& st, const KPoint& k,
+                                double *terms) {
+    const double xi_k = xi(st, k);
+    const double occupation = fermi(st, xi_k);
+    const double sin_part = k.sinX - k.sinY;
+    terms[0] = -k.epsB * occupation;
+    terms[1] = sin_part * sin_part * tanh(st.getBc() * xi_k / 2.0) / xi_k;
+    terms[2] = occupation;
 }
 
-double CritTempSpectrum::innerMu(const CritTempState& st, double kx, 
-                                 double ky) {
-    const double sin_part = sin(kx) - sin(ky);
-    return sin_part * sin_part * tanh(st.getBc() * xi(st, kx, ky) / 2.0) / 
-           xi(st, kx, ky);
+// tanh(beta xi / 2) = 1 - 2 fermi(xi), so each point needs only one exp.
+SCSS_TARGET_CLONES
+void CritTempSpectrum::innerAllBatch(const CritTempState& st, 
+                                     const KGrid& grid, int begin, int end, 
+                                     double *sums) {
+    const CritTempEnvironment& env = st.env;
+    const double coeffA = 2.0 * env.th, 
+                 coeffB = 4.0 * (st.getD1() * env.t0 - env.thp),
+                 epsilonMin = st.getEpsilonMin(), mu = st.getMu(),
+                 beta = st.getBc();
+    const double *sinX = &grid.sinX[0], *sinY = &grid.sinY[0],
+                 *epsA = &grid.epsA[0], *epsB = &grid.epsB[0],
+                 *weight = &grid.weight[0];
+    double sumD1 = 0.0, sumOcc = 0.0, sumTanh = 0.0;
+    #pragma omp simd reduction(+:sumD1,sumOcc,sumTanh)
+    for (int k = begin; k < end; k++) {
+        const double xi_k = coeffA * epsA[k] + coeffB * epsB[k] 
+                            - epsilonMin - mu;
+        const double occupation = 1.0 / (exp(beta * xi_k) + 1.0);
+        const double sin_part = sinX[k] - sinY[k];
+        sumD1 += weight[k] * (-epsB[k] * occupation);
+        sumOcc += weight[k] * occupation;
+        sumTanh += weight[k] 
+                   * (sin_part * sin_part * (1.0 - 2.0 * occupation) / xi_k);
+    }
+    sums[0] = sumD1;
+    sums[1] = sumTanh;
+    sums[2] = sumOcc;
 }
 
+// Mirrors innerAllBatch; the shift epsilonMin + mu is taken in double first.
+SCSS_TARGET_CLONES
+void CritTempSpectrum::innerAllBatchFloat(const CritTempState& st, 
+                                          const KGrid& grid, int begin, 
+                                          int end, double *sums) {
+    const CritTempEnvironment& env = st.env;
+    const float coeffA = 2.0 * env.th, 
+                coeffB = 4.0 * (st.getD1() * env.t0 - env.thp),
+                shift = st.getEpsilonMin() + st.getMu(),
+                beta = st.getBc();
+    const float *sinX = &grid.sinXf[0], *sinY = &grid.sinYf[0],
+                *epsA = &grid.epsAf[0], *epsB = &grid.epsBf[0],
+                *weight = &grid.weightf[0];
+    KahanFloat sumD1, sumOcc, sumTanh;
+    for (int block = begin; block < end; block += SCSS_FLOAT_BLOCK) {
+        const int blockEnd = std::min(block + SCSS_FLOAT_BLOCK, end);
+        float blockD1 = 0.0f, blockOcc = 0.0f, blockTanh = 0.0f;
+        #pragma omp simd reduction(+:blockD1,blockOcc,blockTanh)
+        for (int k = block; k < blockEnd; k++) {
+            const float xi_k = coeffA * epsA[k] + coeffB * epsB[k] - shift;
+            const float occupation = 1.0f / (expf(beta * xi_k) + 1.0f);
+            const float sin_part = sinX[k] - sinY[k];
+            blockD1 += weight[k] * (-epsB[k] * occupation);
+            blockOcc += weight[k] * occupation;
+            blockTanh += weight[k] * (sin_part * sin_part 
+                                      * (1.0f - 2.0f * occupation) / xi_k);
+        }
+        sumD1.add(blockD1);
+        sumOcc.add(blockOcc);
+        sumTanh.add(blockTanh);
+    }
+    sums[0] = sumD1.sum;
+    sums[1] = sumTanh.sum;
+    sums[2] = sumOcc.sum;
+}
+
+// q +/- k/2 isn't on the grid, so those points are built from scratch.
 double CritTempSpectrum::innerPiCommon(const InnerPiInput& ipi, 
-                                       double qx, double qy) {
-    const CritTempState st = ipi.st;
-    double xiPlus = xi(st, qx + ipi.kx / 2, qy + ipi.ky / 2);
-    double xiMinus = xi(st, qx - ipi.kx / 2, qy - ipi.ky / 2);
+                                       const KPoint& q) {
+    const CritTempState& st = ipi.st;
+    double xiPlus = xi(st, KPoint(q.kx + ipi.kx / 2, q.ky + ipi.ky / 2));
+    double xiMinus = xi(st, KPoint(q.kx - ipi.kx / 2, q.ky - ipi.ky / 2));
     double common = -(tanh(st.getBc() * xiPlus / 2) + tanh(st.getBc() 
         * xiMinus / 2)) / (ipi.omega - xiPlus - xiMinus);
     return common;
 }
 
 double CritTempSpectrum::innerPiXX(const InnerPiInput& ipi, 
-                                   double qx, double qy) {
-    double common = innerPiCommon(ipi, qx, qy);
-    return sin(qx) * sin(qx) * common;
+                                   const KPoint& q) {
+    double common = innerPiCommon(ipi, q);
+    return q.sinX * q.sinX * common;
 }
 
 double CritTempSpectrum::innerPiXY(const InnerPiInput& ipi, 
-                                   double qx, double qy) {
-    double common = innerPiCommon(ipi, qx, qy);
-    return sin(qx) * sin(qy) * common;
+                                   const KPoint& q) {
+    double common = innerPiCommon(ipi, q);
+    return q.sinX * q.sinY * common;
 }
 
 double CritTempSpectrum::innerPiYY(const InnerPiInput& ipi, 
-                                   double qx, double qy) {
-    double common = innerPiCommon(ipi, qx, qy);
-    return sin(qy) * sin(qy) * common;
+                                   const KPoint& q) {
+    double common = innerPiCommon(ipi, q);
+    return q.sinY * q.sinY * common;
+}
+
+void CritTempSpectrum::innerPiAll(const InnerPiInput& ipi, const KPoint& q,
+                                  double *terms) {
+    const double common = innerPiCommon(ipi, q);
+    terms[0] = q.sinX * q.sinX * common;
+    terms[1] = q.sinX * q.sinY * common;
+    terms[2] = q.sinY * q.sinY * common;
+}
+
+// The omega-independent parts of innerPiCommon at grid point k: 
+// weight * -(tanh + tanh) in numer and xiPlus + xiMinus in energy.  
+// sin(q +/- k/2) = sin(q) cos(k/2) +/- cos(q) sin(k/2), so no trig 
+// functions are called, and tanh(beta xi / 2) = 1 - 2 fermi(xi) as in 
+// innerAllBatch.  factors is inlined into each batch kernel, so their 
+// loops stay one pass over the grid arrays.
+struct PiShift {
+    PiShift(const InnerPiInput& ipi, const KGrid& grid);
+    SCSS_ALWAYS_INLINE void factors(int k, double& numer, 
+                                    double& energy) const {
+        const double sinXPlus = sinX[k] * cx + cosX[k] * sx,
+                     sinXMinus = sinX[k] * cx - cosX[k] * sx,
+                     sinYPlus = sinY[k] * cy + cosY[k] * sy,
+                     sinYMinus = sinY[k] * cy - cosY[k] * sy;
+        const double sumPlus = sinXPlus + sinYPlus, 
+                     sumMinus = sinXMinus + sinYMinus;
+        const double xiPlus = coeffA * (sumPlus * sumPlus - 1.0)
+                              + coeffB * sinXPlus * sinYPlus - shift,
+                     xiMinus = coeffA * (sumMinus * sumMinus - 1.0)
+                               + coeffB * sinXMinus * sinYMinus - shift;
+        const double tanhPlus = 1.0 - 2.0 / (exp(beta * xiPlus) + 1.0),
+                     tanhMinus = 1.0 - 2.0 / (exp(beta * xiMinus) + 1.0);
+        numer = weight[k] * -(tanhPlus + tanhMinus);
+        energy = xiPlus + xiMinus;
+    }
+    double coeffA, coeffB, shift, beta, cx, sx, cy, sy;
+    const double *sinX, *sinY, *cosX, *cosY, *weight;
+};
+
+PiShift::PiShift(const InnerPiInput& ipi, const KGrid& grid) :
+    coeffA(2.0 * ipi.st.env.th), 
+    coeffB(4.0 * (ipi.st.getD1() * ipi.st.env.t0 - ipi.st.env.thp)),
+    shift(ipi.st.getEpsilonMin() + ipi.st.getMu()), beta(ipi.st.getBc()),
+    cx(ipi.cosHalfX), sx(ipi.sinHalfX), cy(ipi.cosHalfY), 
+    sy(ipi.sinHalfY), sinX(&grid.sinX[0]), sinY(&grid.sinY[0]), 
+    cosX(&grid.cosX[0]), cosY(&grid.cosY[0]), weight(&grid.weight[0]) { }
+
+SCSS_TARGET_CLONES
+void CritTempSpectrum::innerPiBatch(const InnerPiInput& ipi, 
+                                    const KGrid& grid, int begin, int end,
+                                    double *sums) {
+    const PiShift shifted(ipi, grid);
+    const double omega = ipi.omega;
+    const double *sinX = &grid.sinX[0], *sinY = &grid.sinY[0];
+    double sumXX = 0.0, sumXY = 0.0, sumYY = 0.0;
+    #pragma omp simd reduction(+:sumXX,sumXY,sumYY)
+    for (int k = begin; k < end; k++) {
+        double numer, energy;
+        shifted.factors(k, numer, energy);
+        const double common = numer / (omega - energy);
+        sumXX += sinX[k] * sinX[k] * common;
+        sumXY += sinX[k] * sinY[k] * common;
+        sumYY += sinY[k] * sinY[k] * common;
+    }
+    sums[0] = sumXX;
+    sums[1] = sumXY;
+    sums[2] = sumYY;
+}
+
+// Only the denominator depends on omega, so the factors of each block of
+// PI_NODES_BLOCK points are kept on the stack and each omega costs a 
+// division per point.
+SCSS_TARGET_CLONES
+void CritTempSpectrum::innerPiNodesBatch(const InnerPiNodesInput& ipn, 
+                                         const KGrid& grid, int begin, 
+                                         int end, double *sums) {
+    const PiShift shifted(ipn, grid);
+    const int numOmegas = ipn.omegas.size();
+    for (int i = 0; i < 3 * numOmegas; i++) {
+        sums[i] = 0.0;
+    }
+    double numer[PI_NODES_BLOCK], energy[PI_NODES_BLOCK];
+    for (int block = begin; block < end; block += PI_NODES_BLOCK) {
+        const int blockLen = std::min(PI_NODES_BLOCK, end - block);
+        const double *sinX = &grid.sinX[block], *sinY = &grid.sinY[block];
+        #pragma omp simd
+        for (int k = 0; k < blockLen; k++) {
+            shifted.factors(block + k, numer[k], energy[k]);
+        }
+        for (int i = 0; i < numOmegas; i++) {
+            const double omega = ipn.omegas[i];
+            double sumXX = 0.0, sumXY = 0.0, sumYY = 0.0;
+            #pragma omp simd reduction(+:sumXX,sumXY,sumYY)
+            for (int k = 0; k < blockLen; k++) {
+                const double common = numer[k] / (omega - energy[k]);
+                sumXX += sinX[k] * sinX[k] * common;
+                sumXY += sinX[k] * sinY[k] * common;
+                sumYY += sinY[k] * sinY[k] * common;
+            }
+            sums[3 * i] += sumXX;
+            sums[3 * i + 1] += sumXY;
+            sums[3 * i + 2] += sumYY;
+        }
+    }
+}
+
+// d/domega of numer / (omega - energy) is -numer / (omega - energy)^2.
+SCSS_TARGET_CLONES
+void CritTempSpectrum::innerPiDerivBatch(const InnerPiInput& ipi, 
+                                         const KGrid& grid, int begin, 
+                                         int end, double *sums) {
+    const PiShift shifted(ipi, grid);
+    const double omega = ipi.omega;
+    const double *sinX = &grid.sinX[0], *sinY = &grid.sinY[0];
+    double sumXX = 0.0, sumXY = 0.0, sumYY = 0.0,
+           derivXX = 0.0, derivXY = 0.0, derivYY = 0.0;
+    #pragma omp simd reduction(+:sumXX,sumXY,sumYY,derivXX,derivXY,derivYY)
+    for (int k = begin; k < end; k++) {
+        double numer, energy;
+        shifted.factors(k, numer, energy);
+        const double inverse = 1.0 / (omega - energy),
+                     common = numer * inverse,
+                     deriv = -common * inverse;
+        sumXX += sinX[k] * sinX[k] * common;
+        sumXY += sinX[k] * sinY[k] * common;
+        sumYY += sinY[k] * sinY[k] * common;
+        derivXX += sinX[k] * sinX[k] * deriv;
+        derivXY += sinX[k] * sinY[k] * deriv;
+        derivYY += sinY[k] * sinY[k] * deriv;
+    }
+    sums[0] = sumXX;
+    sums[1] = sumXY;
+    sums[2] = sumYY;
+    sums[3] = derivXX;
+    sums[4] = derivXY;
+    sums[5] = derivYY;
 }
 
 double CritTempSpectrum::getLambda(double omega, void *params) {
@@ -109,30 +346,264 @@ double CritTempSpectrum::getLambda(double omega, void *params) {
     const CritTempState& st = lin->st;
     double kx = lin->kx, ky = lin->ky, kz = lin->kz;
 
+    PiOutput Pi = getPi(st, omega, kx, ky);
+    double lambda = lambdaFromPi(*lin, Pi);
+    st.env.debugLog.printf("at (kx = %e, ky = %e, kz = %e), omega = %e:\n"
+                           "Lambda = %e\n", kx, ky, kz, omega, lambda);
+    return lambda;
+}
+
+void CritTempSpectrum::getPiNodes(const CritTempState& st, 
+                                  const std::vector<double>& omegas, 
+                                  double kx, double ky, double *out) {
+    InnerPiNodesInput ipn(st, omegas, kx, ky);
+    BZone::averagesBatch<InnerPiNodesInput>(st, ipn, innerPiNodesBatch, 
+                                            3 * omegas.size(), out,
+                                            KGRID_SYM_INVERSION);
+}
+
+// Clenshaw's recurrence for the Chebyshev series.
+PiOutput CritTempSpectrum::tablePi(const PiTable& table, double omega) {
+    const double x = 2.0 * omega / table.omegaMax - 1.0;
+    double b1[3] = {0.0, 0.0, 0.0}, b2[3] = {0.0, 0.0, 0.0}, pi[3];
+    for (int n = OMEGA_TABLE_NODES - 1; n >= 1; n--) {
+        for (int c = 0; c < 3; c++) {
+            const double b0 = 2.0 * x * b1[c] - b2[c] 
+                              + table.coeffs[3 * n + c];
+            b2[c] = b1[c];
+            b1[c] = b0;
+        }
+    }
+    for (int c = 0; c < 3; c++) {
+        pi[c] = x * b1[c] - b2[c] + table.coeffs[c] / 2.0;
+    }
+    return PiOutput(pi[0], pi[1], pi[2]);
+}
+
+double CritTempSpectrum::tableLambda(double omega, void *params) {
+    const PiTable *table = (const PiTable*)params;
+    return lambdaFromPi(table->lin, tablePi(*table, omega));
+}
+
+double CritTempSpectrum::lambdaFromPi(const LambdaInput& lin, 
+                                      const PiOutput& Pi) {
+    const CritTempState& st = lin.st;
+    double kx = lin.kx, ky = lin.ky, kz = lin.kz;
     double ex = 2 * (st.env.t0 * cos(ky) + st.env.tz * cos(kz)),
            ey = 2 * (st.env.t0 * cos(kx) + st.env.tz * cos(kz));
-    PiOutput Pi = getPi(st, omega, kx, ky);
     double firstTerm = (ex * Pi.xx + ey * Pi.yy) / 2 - 1;
     double secondTerm = sqrt(pow((ex * Pi.xx - ey * Pi.yy), 2.0) / 4
         + ex * ey * pow(Pi.xy, 2.0));
+    if (lin.lambdaMinus) {
+        return firstTerm - secondTerm;
+    } else {
+        return firstTerm + secondTerm;
+    } 
+}
 
-    st.env.debugLog.printf("at (kx = %e, ky = %e, kz = %e), omega = %e:\n"
-                           "Lambda first = %e, second = %e\n", kx, ky, kz,
-                           omega, firstTerm, secondTerm);
-    if (lin->lambdaMinus) {
+// 1 / x = int dt exp(t - x e^t).  With t = u - exp(-u) the integrand in u
+// falls off double exponentially both ways, so the trapezoid rule gives
+// 1 / x = sum_n coeffs[n] exp(-taus[n] x) to about PI_GRID_TOL for all x
+// in [low, high].
+static void inverseExpSum(double low, double high, std::vector<double>& taus,
+                          std::vector<double>& coeffs) {
+    const double uMin = -log(log(high / PI_GRID_TOL) + 1.0),
+                 uMax = log(-log(PI_GRID_TOL) / low) + 1.0;
+    const int numNodes = (int)ceil((uMax - uMin) / PI_GRID_STEP) + 1;
+    for (int n = 0; n < numNodes; n++) {
+        const double u = uMin + n * PI_GRID_STEP, t = u - exp(-u);
+        taus.push_back(exp(t));
+        coeffs.push_back(PI_GRID_STEP * (1.0 + exp(-u)) * exp(t));
+    }
+}
+
+// With p = q + k/2, Pi_ab(k) = <s_a(p - k/2) s_b(p - k/2) (t(p) + t(p - k))
+// / (xi(p) + xi(p - k) - omega)>_p with t = tanh(beta xi / 2).  The sines 
+// split by angle addition into functions of p times functions of k, and
+// with inverseExpSum every exponential factors too, so each term is a 
+// correlation sum_p a(p) b(p - k), which is A(m) conj(B(m)) after a 
+// forward FFT.  Two real arrays share each complex FFT, split afterwards 
+// using F(-m) = conj(F(m)) for real f.
+bool CritTempSpectrum::getPiGrid(const CritTempState& st, double omega,
+                                 std::vector<double>& out) {
+    const CritTempEnvironment& env = st.env;
+    const int N = st.getGridLen(), numPoints = N * N;
+    if (N % 2 != 0) {
+        env.errorLog.printf("getPiGrid needs an even gridLen, not %d\n", N);
+        return false;
+    }
+    const KGrid& grid = KGrid::forGridLen(N);
+    const double coeffA = 2.0 * env.th, 
+                 coeffB = 4.0 * (st.getD1() * env.t0 - env.thp),
+                 shift = st.getEpsilonMin() + st.getMu(),
+                 beta = st.getBc();
+    // Energies are shifted by omega / 2 each, so exp(omega tau) never 
+    // appears on its own.
+    std::vector<double> energy(numPoints), tanhs(numPoints);
+    double energyMin = 0.0, energyMax = 0.0;
+    for (int k = 0; k < numPoints; k++) {
+        const double xi_k = coeffA * grid.epsA[k] + coeffB * grid.epsB[k]
+                            - shift;
+        energy[k] = xi_k - omega / 2.0;
+        tanhs[k] = tanh(beta * xi_k / 2.0);
+        if (k == 0 || energy[k] < energyMin) {
+            energyMin = energy[k];
+        }
+        if (k == 0 || energy[k] > energyMax) {
+            energyMax = energy[k];
+        }
+    }
+    if (!(energyMin > 0.0)) {
+        env.errorLog.printf("getPiGrid needs omega = %e below twice the "
+                            "smallest xi, %e\n", omega, 
+                            2.0 * energyMin + omega);
+        return false;
+    }
+    std::vector<double> taus, coeffs;
+    inverseExpSum(2.0 * energyMin, 2.0 * energyMax, taus, coeffs);
+    // The functions of p the sines split into: sin^2, sin cos, cos^2 of 
+    // px and of py, then sx sy, sx cy, cx sy, cx cy.
+    const int numWeights = 10;
+    std::vector<double> weights(numWeights * numPoints);
+    for (int k = 0; k < numPoints; k++) {
+        const double sx = grid.sinX[k], sy = grid.sinY[k],
+                     cx = grid.cosX[k], cy = grid.cosY[k];
+        const double w[numWeights] = {sx * sx, sx * cx, cx * cx, 
+                                      sy * sy, sy * cy, cy * cy,
+                                      sx * sy, sx * cy, cx * sy, cx * cy};
+        for (int j = 0; j < numWeights; j++) {
+            weights[j * numPoints + k] = w[j];
+        }
+    }
+    FFT2D fft(N);
+    std::vector<double> expE(numPoints), packedB(2 * numPoints), 
+                        packedA(2 * numPoints),
+                        corr(2 * numWeights * numPoints, 0.0);
+    for (size_t n = 0; n < taus.size(); n++) {
+        // b(p) = exp(-tau E) and b'(p) = t exp(-tau E); then for each 
+        // weight w, a = w t exp(-tau E) pairs with b and a' = w exp(-tau E)
+        // with b'.
+        for (int k = 0; k < numPoints; k++) {
+            expE[k] = exp(-taus[n] * energy[k]);
+            packedB[2 * k] = expE[k];
+            packedB[2 * k + 1] = tanhs[k] * expE[k];
+        }
+        fft.forward(&packedB[0]);
+        for (int j = 0; j < numWeights; j++) {
+            const double *w = &weights[j * numPoints];
+            for (int k = 0; k < numPoints; k++) {
+                packedA[2 * k] = w[k] * tanhs[k] * expE[k];
+                packedA[2 * k + 1] = w[k] * expE[k];
+            }
+            fft.forward(&packedA[0]);
+            double *c = &corr[2 * j * numPoints];
+            for (int my = 0; my < N; my++) {
+                for (int mx = 0; mx < N; mx++) {
+                    const int m = my * N + mx,
+                              minus = ((N - my) % N) * N + (N - mx) % N;
+                    // F = (Z(m) + conj Z(-m)) / 2, F' = (Z(m) - conj 
+                    // Z(-m)) / 2i for Z = F + i F'.
+                    const double zr = packedA[2 * m], 
+                                 zi = packedA[2 * m + 1],
+                                 wr = packedA[2 * minus], 
+                                 wi = packedA[2 * minus + 1];
+                    const double ar = (zr + wr) / 2.0, ai = (zi - wi) / 2.0,
+                                 apr = (zi + wi) / 2.0, 
+                                 api = -(zr - wr) / 2.0;
+                    const double yr = packedB[2 * m], 
+                                 yi = packedB[2 * m + 1],
+                                 vr = packedB[2 * minus], 
+                                 vi = packedB[2 * minus + 1];
+                    const double br = (yr + vr) / 2.0, bi = (yi - vi) / 2.0,
+                                 bpr = (yi + vi) / 2.0, 
+                                 bpi = -(yr - vr) / 2.0;
+                    // A conj(B) + A' conj(B')
+                    c[2 * m] += coeffs[n] * (ar * br + ai * bi 
+                                             + apr * bpr + api * bpi);
+                    c[2 * m + 1] += coeffs[n] * (ai * br - ar * bi 
+                                                 + api * bpr - apr * bpi);
+                }
+            }
+        }
+    }
+    // One 1 / N^2 undoes the transforms, one averages over p.
+    const double norm = 1.0 / ((double)numPoints * numPoints),
+                 step = 2.0 * M_PI / N;
+    for (int j = 0; j < numWeights; j++) {
+        fft.backward(&corr[2 * j * numPoints]);
+    }
+    // Only even (mx, my) put q + k/2 on the grid, as getPi's sum does.
+    const int M = N / 2;
+    out.assign(3 * M * M, 0.0);
+    for (int ly = 0; ly < M; ly++) {
+        const double cy = cos(ly * step), sy = sin(ly * step);
+        for (int lx = 0; lx < M; lx++) {
+            const double cx = cos(lx * step), sx = sin(lx * step);
+            const int m = 2 * ly * N + 2 * lx, l = ly * M + lx;
+            double C[numWeights];
+            for (int j = 0; j < numWeights; j++) {
+                C[j] = norm * corr[2 * (j * numPoints + m)];
+            }
+            out[3 * l] = cx * cx * C[0] - 2.0 * cx * sx * C[1] 
+                         + sx * sx * C[2];
+            out[3 * l + 1] = cx * cy * C[6] - cx * sy * C[7] 
+                             - sx * cy * C[8] + sx * sy * C[9];
+            out[3 * l + 2] = cy * cy * C[3] - 2.0 * cy * sy * C[4] 
+                             + sy * sy * C[5];
+        }
+    }
+    return true;
+}
+
+double CritTempSpectrum::lambdaDerivFromPi(const LambdaInput& lin, 
+                                           const PiOutput& Pi, 
+                                           const PiOutput& dPi) {
+    const CritTempState& st = lin.st;
+    double kx = lin.kx, ky = lin.ky, kz = lin.kz;
+    double ex = 2 * (st.env.t0 * cos(ky) + st.env.tz * cos(kz)),
+           ey = 2 * (st.env.t0 * cos(kx) + st.env.tz * cos(kz));
+    double firstTerm = (ex * dPi.xx + ey * dPi.yy) / 2;
+    double diff = ex * Pi.xx - ey * Pi.yy;
+    double root = sqrt(diff * diff / 4 + ex * ey * Pi.xy * Pi.xy);
+    if (root == 0.0) {
+        return firstTerm;
+    }
+    double secondTerm = (diff * (ex * dPi.xx - ey * dPi.yy) / 4
+        + ex * ey * Pi.xy * dPi.xy) / root;
+    if (lin.lambdaMinus) {
         return firstTerm - secondTerm;
     } else {
         return firstTerm + secondTerm;
     } 
 }
 
+double CritTempSpectrum::getLambdaDeriv(const LambdaInput& lin, 
+                                        double omega, double *dLambda) {
+    double pi[6];
+    getPiDeriv(lin.st, omega, lin.kx, lin.ky, pi);
+    const PiOutput Pi(pi[0], pi[1], pi[2]), dPi(pi[3], pi[4], pi[5]);
+    *dLambda = lambdaDerivFromPi(lin, Pi, dPi);
+    return lambdaFromPi(lin, Pi);
+}
+
+void CritTempSpectrum::getPiDeriv(const CritTempState& st, double omega,
+                                  double kx, double ky, double *out) {
+    InnerPiInput ipi(st, omega, kx, ky);
+    BZone::averagesBatch<InnerPiInput>(st, ipi, innerPiDerivBatch, 6, out,
+                                       KGRID_SYM_INVERSION);
+}
+
 PiOutput CritTempSpectrum::getPi(const CritTempState& st, double omega,
                                  double kx, double ky) {
     InnerPiInput ipi(st, omega, kx, ky);
-    double piXX = BZone::average<InnerPiInput>(st, ipi, innerPiXX);
-    double piXY = BZone::average<InnerPiInput>(st, ipi, innerPiXY);
-    double piYY = BZone::average<InnerPiInput>(st, ipi, innerPiYY);
-    PiOutput out(piXX, piXY, piYY);
+    double pi[3];
+    if (st.env.kernelMode == "scalar") {
+        BZone::averages<InnerPiInput>(st, ipi, innerPiAll, 3, pi);
+    } else {
+        BZone::averagesBatch<InnerPiInput>(st, ipi, innerPiBatch, 3, pi,
+                                           KGRID_SYM_INVERSION);
+    }
+    PiOutput out(pi[0], pi[1], pi[2]);
     return out;
 }
 
@@ -140,11 +611,126 @@ double CritTempSpectrum::nuFunction(double y, void *params) {
     return sqrt(y) / (exp(y) - 1);
 }
 
-double CritTempSpectrum::getNu(const CritTempState& st) {
-    OmegaCoeffs ocs = getOmegaCoeffs(st);
-    Integrator integrator(&nuFunction, NULL, 1e-6, 1e-6);
-    double integral = integrator.doIntegral(0.0, -2 * st.getMu() * st.getBc(),
-                                            st.env.errorLog);
+// Below 2 pi, y / (e^y - 1) = sum_n B_n y^n / n!, so the integral is 
+// sum_n B_n a^(n + 1/2) / (n! (n + 1/2)); B_n = 0 for odd n > 1.  Above,
+// the integral to infinity is Gamma(3/2) zeta(3/2), less
+// sum_k int_a^inf sqrt(y) e^(-k y) dy = sum_k Gamma(3/2, k a) / k^(3/2),
+// with Gamma(3/2, x) = sqrt(x) e^(-x) + sqrt(pi) erfc(sqrt(x)) / 2.
+double CritTempSpectrum::boseIntegral(double a) {
+    if (a <= 0.0) {
+        return 0.0;
+    }
+    if (a <= BOSE_SERIES_MAX) {
+        // B_2, B_4, ..., B_30; at a = 2 the next term is below 1e-17.
+        static const double bernoulli[15] = {1.0 / 6.0, -1.0 / 30.0, 
+            1.0 / 42.0, -1.0 / 30.0, 5.0 / 66.0, -691.0 / 2730.0, 7.0 / 6.0,
+            -3617.0 / 510.0, 43867.0 / 798.0, -174611.0 / 330.0, 
+            854513.0 / 138.0, -236364091.0 / 2730.0, 8553103.0 / 6.0, 
+            -23749461029.0 / 870.0, 8615841276005.0 / 14322.0};
+        const double root = sqrt(a);
+        // n = 0 and n = 1 terms
+        double sum = 2.0 * root - a * root / 3.0;
+        double power = a * root, factorial = 1.0;
+        for (int m = 1; m <= 15; m++) {
+            power *= a;
+            factorial *= (2 * m) * (2 * m - 1);
+            if (m > 1) {
+                power *= a;
+            }
+            sum += bernoulli[m - 1] / factorial * power / (2 * m + 0.5);
+        }
+        return sum;
+    }
+    // Gamma(3/2) zeta(3/2)
+    const double whole = 2.315157373394117;
+    double tail = 0.0;
+    for (int k = 1; k * a < 40.0; k++) {
+        const double x = k * a;
+        tail += (sqrt(x) * exp(-x) + sqrt(M_PI) * erfc(sqrt(x)) / 2.0) 
+                / (k * sqrt((double)k));
+    }
+    return whole - tail;
+}
+
+// Log how long one of getNu's tasks took, to show the critical path.
+static void logTask(const CritTempState& st, const char *name, 
+                    double start) {
+    st.env.debugLog.printf("task %s took %e s on thread %d\n", name, 
+                           omp_get_wtime() - start, omp_get_thread_num());
+}
+
+// While one exists, the grid passes of getNu's tasks run as nested 
+// parallel regions on their ThreadShare instead of serially.
+class NestedPasses {
+public:
+    NestedPasses() : previous(omp_get_max_active_levels()) {
+        omp_set_max_active_levels(std::max(previous, 2));
+    }
+    ~NestedPasses() {
+        omp_set_max_active_levels(previous);
+    }
+private:
+    const int previous;
+};
+
+// Whether getOmegaCoeffs does the three root solves, the only part of 
+// getNu worth running side by side.
+static bool usesRootSolves(const CritTempState& st) {
+    const std::string& mode = st.env.omegaCoeffsMode;
+    return mode == "exact" || mode == "validate" || st.getMu() >= 0.0;
+}
+
+static double nuIntegral(const CritTempState& st) {
+    const double start = omp_get_wtime(),
+                 upper = -2 * st.getMu() * st.getBc();
+    double integral;
+    if (st.env.nuIntegralMode == "integrator") {
+        Integrator integrator(&CritTempSpectrum::nuFunction, NULL, 1e-6, 
+                              1e-6);
+        const IntegralResult result = integrator.integrate(0.0, upper);
+        integral = result.value;
+        st.env.debugLog.printf("nu integral error estimate %e after %d "
+                               "evaluations\n", result.error,
+                               result.evaluations);
+        if (!result.converged) {
+            st.env.errorLog.printf("nu integral to %e not converged\n", 
+                                   upper);
+        }
+    } else {
+        integral = CritTempSpectrum::boseIntegral(upper);
+    }
+    logTask(st, "nu integral", start);
+    return integral;
+}
+
+// The integral doesn't depend on the omega coefficients, so when the root
+// solves are needed it's a task running alongside them; rootOmegaCoeffs 
+// adds its root solves as tasks of the same team.  Otherwise everything
+// runs in order and the expansion's pass gets all of numThreads.
+double CritTempSpectrum::getNu(const CritTempState& st, 
+                               OmegaCoeffs *ocsOut) {
+    const double start = omp_get_wtime();
+    OmegaCoeffs ocs;
+    double integral = 0.0;
+    if (st.env.numThreads > 1 && usesRootSolves(st)) {
+        NestedPasses nested;
+        #pragma omp parallel num_threads(std::min(st.env.numThreads, \
+                                                  CRIT_MAX_TASKS))
+        #pragma omp single
+        {
+            #pragma omp task shared(integral)
+            integral = nuIntegral(st);
+            ocs = getOmegaCoeffs(st);
+            #pragma omp taskwait
+        }
+    } else {
+        integral = nuIntegral(st);
+        ocs = getOmegaCoeffs(st);
+    }
+    logTask(st, "getNu", start);
+    if (ocsOut != NULL) {
+        *ocsOut = ocs;
+    }
     st.env.debugLog.printf("integral = %e\n"
                            "planar = %e cross = %e perp = %e\n", integral,
                            ocs.planar, ocs.cross, ocs.perp);
@@ -154,11 +740,178 @@ double CritTempSpectrum::getNu(const CritTempState& st) {
 }
 
 OmegaCoeffs CritTempSpectrum::getOmegaCoeffs(const CritTempState& st) {
+    const std::string& mode = st.env.omegaCoeffsMode;
+    if (mode == "exact" || st.getMu() >= 0.0) {
+        return rootOmegaCoeffs(st);
+    }
+    double lambda0, dOmega;
+    const OmegaCoeffs ocs = expandOmegaCoeffs(st, &lambda0, &dOmega);
+    if (mode == "validate") {
+        const OmegaCoeffs roots = rootOmegaCoeffs(st);
+        st.env.debugLog.printf("omega coeffs expanded: planar = %e "
+                               "perp = %e cross = %e; root solves: "
+                               "planar = %e perp = %e cross = %e; "
+                               "lambda0 = %e dOmega = %e\n", ocs.planar,
+                               ocs.perp, ocs.cross, roots.planar, 
+                               roots.perp, roots.cross, lambda0, dOmega);
+        const double scale = fabs(ocs.planar) + fabs(ocs.perp);
+        if (fabs(ocs.planar - roots.planar) > OMEGA_COEFFS_VALIDATE_TOL 
+                                              * scale
+            || fabs(ocs.perp - roots.perp) > OMEGA_COEFFS_VALIDATE_TOL 
+                                             * scale
+            || fabs(ocs.cross - roots.cross) > OMEGA_COEFFS_VALIDATE_TOL 
+                                               * scale) {
+            st.env.errorLog.printf("Expanded omega coeffs (%e, %e, %e) "
+                                   "disagree with root solves (%e, %e, "
+                                   "%e); Lambda(0, 0) = %e\n", ocs.planar,
+                                   ocs.perp, ocs.cross, roots.planar, 
+                                   roots.perp, roots.cross, lambda0);
+        }
+    }
+    return ocs;
+}
+
+// One task per root solve, joined before returning.  numThreads is split
+// between them for their grid passes.
+static void rootOmegaTasks(const CritTempState& st, double small_k, 
+                           double *omegas) {
+    static const char *names[3] = {"omega planar", "omega perp", 
+                                   "omega cross"};
+    const double ks[3][3] = {{small_k, 0.0, 0.0}, {0.0, 0.0, small_k},
+                             {small_k, small_k, 0.0}};
+    const int numThreads = st.env.numThreads;
+    for (int i = 0; i < 3; i++) {
+        #pragma omp task firstprivate(i)
+        {
+            const double start = omp_get_wtime();
+            ThreadShare share(std::max(1, numThreads / 3 
+                                          + (i < numThreads % 3 ? 1 : 0)));
+            omegas[i] = CritTempSpectrum::omegaExact(st, ks[i][0], ks[i][1],
+                                                     ks[i][2]);
+            logTask(st, names[i], start);
+        }
+    }
+    #pragma omp taskwait
+}
+
+// Called from getNu, the tasks join its team; otherwise they get their own,
+// or run in order with one thread.
+OmegaCoeffs CritTempSpectrum::rootOmegaCoeffs(const CritTempState& st) {
     double small_k = 0.05, sks = small_k * small_k;
+    double omegas[3];
+    if (omp_in_parallel() || st.env.numThreads <= 1) {
+        rootOmegaTasks(st, small_k, omegas);
+    } else {
+        NestedPasses nested;
+        #pragma omp parallel num_threads(std::min(st.env.numThreads, 3))
+        #pragma omp single
+        rootOmegaTasks(st, small_k, omegas);
+    }
     OmegaCoeffs ocs;
-    ocs.planar = omegaExact(st, small_k, 0.0, 0.0) / sks;
-    ocs.perp = omegaExact(st, 0.0, 0.0, small_k) / sks;
-    ocs.cross = omegaExact(st, small_k, small_k, 0.0) / sks - 2 * ocs.planar;
+    ocs.planar = omegas[0] / sks;
+    ocs.perp = omegas[1] / sks;
+    ocs.cross = omegas[2] / sks - 2 * ocs.planar;
+    return ocs;
+}
+
+// With xi(q +/- k/2) = xi +/- g.k/2 + k^T H k/8 and f = tanh(beta xi / 2),
+// innerPiCommon = -(f(xi+) + f(xi-)) / (omega - xi+ - xi-) at omega = 0 is
+// f / xi + k^T [(f' H + f'' g g^T) / (8 xi) - f H / (8 xi^2)] k, and its 
+// omega derivative is f / (2 xi^2).
+SCSS_TARGET_CLONES
+void CritTempSpectrum::piExpansionBatch(const CritTempState& st, 
+                                        const KGrid& grid, int begin, 
+                                        int end, double *sums) {
+    const CritTempEnvironment& env = st.env;
+    const double coeffA = 2.0 * env.th, 
+                 coeffB = 4.0 * (st.getD1() * env.t0 - env.thp),
+                 shift = st.getEpsilonMin() + st.getMu(),
+                 beta = st.getBc();
+    for (int i = 0; i < 15; i++) {
+        sums[i] = 0.0;
+    }
+    for (int k = begin; k < end; k++) {
+        const double sx = grid.sinX[k], sy = grid.sinY[k],
+                     cx = grid.cosX[k], cy = grid.cosY[k],
+                     sumSin = sx + sy;
+        const double xi_k = coeffA * (sumSin * sumSin - 1.0) 
+                            + coeffB * sx * sy - shift;
+        const double gx = 2.0 * coeffA * sumSin * cx + coeffB * cx * sy,
+                     gy = 2.0 * coeffA * sumSin * cy + coeffB * sx * cy,
+                     hxx = 2.0 * coeffA * (cx * cx - sumSin * sx) 
+                           - coeffB * sx * sy,
+                     hxy = (2.0 * coeffA + coeffB) * cx * cy,
+                     hyy = 2.0 * coeffA * (cy * cy - sumSin * sy) 
+                           - coeffB * sx * sy;
+        const double f = 1.0 - 2.0 / (exp(beta * xi_k) + 1.0),
+                     f1 = beta * (1.0 - f * f) / 2.0,
+                     f2 = -beta * f * f1;
+        const double w = grid.weight[k],
+                     pi0 = w * f / xi_k,
+                     piOmega = w * f / (2.0 * xi_k * xi_k),
+                     hScale = w * (f1 / (8.0 * xi_k) 
+                                   - f / (8.0 * xi_k * xi_k)),
+                     gScale = w * f2 / (8.0 * xi_k);
+        const double q[3] = {hScale * hxx + gScale * gx * gx,
+                             hScale * hxy + gScale * gx * gy,
+                             hScale * hyy + gScale * gy * gy};
+        const double s[3] = {sx * sx, sx * sy, sy * sy};
+        for (int a = 0; a < 3; a++) {
+            sums[a] += s[a] * pi0;
+            sums[3 + a] += s[a] * piOmega;
+            for (int b = 0; b < 3; b++) {
+                sums[6 + 3 * a + b] += s[a] * q[b];
+            }
+        }
+    }
+}
+
+// Lambda minus = G(Pi, ex, ey); at k = 0 the changes in Pi, ex and ey are
+// all second order in k, so G's first derivatives are enough.
+OmegaCoeffs CritTempSpectrum::expandOmegaCoeffs(const CritTempState& st,
+                                                double *lambda0, 
+                                                double *dOmega) {
+    double sums[15];
+    BZone::averagesBatch<CritTempState>(st, st, piExpansionBatch, 15, sums,
+                                        KGRID_SYM_INVERSION);
+    const double t0 = st.env.t0, tz = st.env.tz, 
+                 e0 = 2.0 * (t0 + tz),
+                 pxx = sums[0], pxy = sums[1], pyy = sums[2];
+    const double diff = e0 * (pxx - pyy),
+                 root = sqrt(diff * diff / 4.0 + e0 * e0 * pxy * pxy);
+    // dG/d(Pi xx, Pi xy, Pi yy), dG/d(ex), dG/d(ey)
+    double dPi[3], dEx, dEy;
+    if (root > 0.0) {
+        dPi[0] = e0 / 2.0 - diff * e0 / (4.0 * root);
+        dPi[1] = -e0 * e0 * pxy / root;
+        dPi[2] = e0 / 2.0 + diff * e0 / (4.0 * root);
+        dEx = pxx / 2.0 - (diff * pxx / 2.0 + e0 * pxy * pxy) / (2.0 * root);
+        dEy = pyy / 2.0 - (-diff * pyy / 2.0 + e0 * pxy * pxy) 
+                          / (2.0 * root);
+    } else {
+        dPi[0] = dPi[2] = e0 / 2.0;
+        dPi[1] = 0.0;
+        dEx = pxx / 2.0;
+        dEy = pyy / 2.0;
+    }
+    double lambdaOmega = 0.0, quad[3] = {0.0, 0.0, 0.0};
+    for (int a = 0; a < 3; a++) {
+        lambdaOmega += dPi[a] * sums[3 + a];
+        for (int b = 0; b < 3; b++) {
+            quad[b] += dPi[a] * sums[6 + 3 * a + b];
+        }
+    }
+    // ex = 2 (t0 cos ky + tz cos kz) and ey = 2 (t0 cos kx + tz cos kz).
+    OmegaCoeffs ocs;
+    ocs.planar = -(quad[0] - t0 * dEy) / lambdaOmega;
+    ocs.cross = -2.0 * quad[1] / lambdaOmega;
+    ocs.perp = tz * (dEx + dEy) / lambdaOmega;
+    if (lambda0 != NULL) {
+        *lambda0 = e0 * (pxx + pyy) / 2.0 - 1.0 - root;
+    }
+    if (dOmega != NULL) {
+        *dOmega = lambdaOmega;
+    }
     return ocs;
 }
 
@@ -170,9 +923,25 @@ double CritTempSpectrum::omegaApprox(const OmegaCoeffs& oc,
 
 double CritTempSpectrum::omegaExact(const CritTempState& st, 
                                     double kx, double ky, double kz) {
+    if (st.env.omegaRootMode == "table") {
+        const double omega = omegaFromTable(st, kx, ky, kz);
+        if (omega >= 0.0) {
+            return omega;
+        }
+        st.env.debugLog.printf("No root of Lambda on the Pi table at"
+                               " k = (%f, %f, %f)\n", kx, ky, kz);
+    } else if (st.env.omegaRootMode == "newton") {
+        const double omega = omegaNewton(st, kx, ky, kz);
+        if (omega >= 0.0) {
+            return omega;
+        }
+        st.env.debugLog.printf("Newton's method left [0, -2 mu] before"
+                               " bracketing a root of Lambda at"
+                               " k = (%f, %f, %f)\n", kx, ky, kz);
+    }
     LambdaInput lin(st, kx, ky, kz, true);
     RootFinder rf(&CritTempSpectrum::getLambda, &lin, 0.05, 0.0, 100.0, 
-                  1e-6);
+                  OMEGA_ROOT_TOL);
     const RootData& rootData = rf.findRoot();
     if (!rootData.converged) {
         st.env.errorLog.printf("Failed to find root of Lambda at"
@@ -181,3 +950,73 @@ double CritTempSpectrum::omegaExact(const CritTempState& st,
     }
     return rootData.root;
 }
+
+double CritTempSpectrum::omegaFromTable(const CritTempState& st, 
+                                        double kx, double ky, double kz) {
+    const double omegaMax = -2.0 * OMEGA_TABLE_FRACTION * st.getMu();
+    if (omegaMax <= 0.0) {
+        return -1;
+    }
+    LambdaInput lin(st, kx, ky, kz, true);
+    PiTable table(lin, omegaMax);
+    RootFinder rf(&CritTempSpectrum::tableLambda, &table, 
+                  std::min(0.05, omegaMax / 2.0), 0.0, omegaMax, 
+                  OMEGA_ROOT_TOL);
+    const RootData& rootData = rf.findRoot();
+    if (!rootData.converged) {
+        return -1;
+    }
+    const double root = rootData.root,
+                 below = getLambda(root - OMEGA_ROOT_TOL, &lin),
+                 above = getLambda(root + OMEGA_ROOT_TOL, &lin);
+    if (!((below <= 0.0 && above >= 0.0) || (below >= 0.0 && above <= 0.0))) {
+        st.env.debugLog.printf("Pi table root %e at k = (%f, %f, %f) failed"
+                               " the exact check\n", root, kx, ky, kz);
+        return -1;
+    }
+    return root;
+}
+
+double CritTempSpectrum::omegaNewton(const CritTempState& st, double kx, 
+                                     double ky, double kz) {
+    const double omegaMax = -2.0 * st.getMu();
+    if (omegaMax <= 0.0) {
+        return -1;
+    }
+    LambdaInput lin(st, kx, ky, kz, true);
+    double dLambda, omega = 0.0;
+    double lambda = getLambdaDeriv(lin, omega, &dLambda);
+    // Lambda has lambdaLow's sign at low; it's only known to change sign
+    // by high once bracketed.
+    double low = 0.0, high = omegaMax, lambdaLow = lambda;
+    bool bracketed = false;
+    for (int i = 0; i < OMEGA_NEWTON_MAX_ITER; i++) {
+        if (lambda == 0.0) {
+            return omega;
+        }
+        double next = omega - lambda / dLambda;
+        if (!(next > low && next < high)) {
+            if (!bracketed) {
+                return -1;
+            }
+            next = (low + high) / 2.0;
+        }
+        const double step = next - omega;
+        omega = next;
+        lambda = getLambdaDeriv(lin, omega, &dLambda);
+        if ((lambda > 0.0) == (lambdaLow > 0.0)) {
+            low = omega;
+            lambdaLow = lambda;
+        } else {
+            high = omega;
+            bracketed = true;
+        }
+        if (fabs(step) < OMEGA_ROOT_TOL) {
+            st.env.debugLog.printf("Newton root of Lambda %e at k = (%f, %f,"
+                                   " %f) after %d passes\n", omega, kx, ky, 
+                                   kz, i + 2);
+            return omega;
+        }
+    }
+    return -1;
+}
@@ -24,11 +24,43 @@
 #define __SCSS_CRIT_TEMP_SPECTRUM_H
 
 #include <cmath>
+#include <vector>
 
 #include "CritTempState.hh"
 #include "BZone.hh"
 #include "RootFinder.hh"
 #include "Integrator.hh"
+#include "KGrid.hh"
+#include "Vectorize.hh"
+#include "FFT2D.hh"
+
+// omegaExact's tolerance on the root of Lambda.
+#define OMEGA_ROOT_TOL 1e-6
+// Most Newton steps omegaNewton takes before giving up.
+#define OMEGA_NEWTON_MAX_ITER 50
+// With omegaRootMode "table", Pi(omega) is interpolated over
+// [0, OMEGA_TABLE_FRACTION * (-2 mu)] through this many Chebyshev nodes.
+// xi >= -mu, so Pi's poles all lie above -2 mu and the interpolant 
+// converges quickly on that interval.
+#define OMEGA_TABLE_NODES 16
+#define OMEGA_TABLE_FRACTION 0.5
+// innerPiNodesBatch keeps the omega-independent factors of this many grid
+// points on the stack at once.
+#define PI_NODES_BLOCK 64
+// omegaCoeffsMode "validate" logs an error if the expansion and the root
+// solves disagree by more than this relative amount.
+#define OMEGA_COEFFS_VALIDATE_TOL 1e-2
+// getPiGrid writes 1 / x as a sum of exponentials, good to about 
+// PI_GRID_TOL relative; PI_GRID_STEP is the trapezoid rule's step.
+#define PI_GRID_TOL 1e-13
+#define PI_GRID_STEP 0.2
+// getNu runs its independent pieces (the nu integral and up to three root
+// solves) as tasks on at most this many of env.numThreads; the root 
+// solves split all of env.numThreads between their grid passes.
+#define CRIT_MAX_TASKS 4
+// boseIntegral uses the Bernoulli series up to this upper limit and the 
+// complement's exponential sum above it.
+#define BOSE_SERIES_MAX 2.0
 
 struct OmegaCoeffs {
     double planar, perp, cross;
@@ -52,45 +84,162 @@ struct InnerPiInput {
                  double _kx, double _ky);
     double omega, kx, ky;
     const CritTempState& st;
+    // cos and sin of kx / 2 and ky / 2, for shifting grid points by k / 2.
+    double cosHalfX, sinHalfX, cosHalfY, sinHalfY;
+};
+
+// Pi at every omega in omegas for the same k (omega is unused).
+struct InnerPiNodesInput : public InnerPiInput {
+    InnerPiNodesInput(const CritTempState& _st, 
+                      const std::vector<double>& _omegas, 
+                      double _kx, double _ky);
+    const std::vector<double>& omegas;
+};
+
+// Chebyshev interpolant of Pi(omega) on [0, omegaMax] at lin's k, built 
+// from one getPiNodes pass.
+struct PiTable {
+    PiTable(const LambdaInput& _lin, double _omegaMax);
+    const LambdaInput& lin;
+    double omegaMax;
+    // Coefficient of T_n(2 omega / omegaMax - 1) in component c (xx, xy,
+    // yy) is coeffs[3 * n + c].
+    std::vector<double> coeffs;
 };
 
 class CritTempSpectrum {
 public:
     // One-hole spectrum to be used, minimum at 0
-    static double epsilon(const CritTempState& st, double kx, double ky);
+    static double epsilon(const CritTempState& st, const KPoint& k);
     // One-hole spectrum unmodified from theory
-    static double epsilonBar(const CritTempState& st, double kx, double ky);
+    static double epsilonBar(const CritTempState& st, const KPoint& k);
     // One-hole energy, epsilon - mu
-    static double xi(const CritTempState& st, double kx, double ky);
+    static double xi(const CritTempState& st, const KPoint& k);
     // Fermi distribution function (for T>0)
     static double fermi(const CritTempState& st, double energy);
     // Bose distribution function (T>0)
     static double bose(const CritTempState& st, double energy);
     // term to be summed to calculate x1 (x2 = x - x1)
-    static double innerX1(const CritTempState& st, double kx, double ky);
+    static double innerX1(const CritTempState& st, const KPoint& k);
     // term to be summed to calculate rhs of associated S-C equation
-    static double innerD1(const CritTempState& st, double kx, double ky);
-    static double innerMu(const CritTempState& st, double kx, double ky);
+    static double innerD1(const CritTempState& st, const KPoint& k);
+    static double innerMu(const CritTempState& st, const KPoint& k);
+    // all three terms at once, sharing xi:
+    // terms = {innerD1, innerMu, innerX1}
+    static void innerAll(const CritTempState& st, const KPoint& k, 
+                         double *terms);
+    // Weighted sums of innerAll's terms over grid points [begin, end), 
+    // computed straight from the grid arrays so the loop vectorizes.
+    static void innerAllBatch(const CritTempState& st, const KGrid& grid, 
+                              int begin, int end, double *sums);
+    // Same sums in single precision (see SCSS_FLOAT_BLOCK), for early
+    // iterations where twice the SIMD width matters more than accuracy.
+    static void innerAllBatchFloat(const CritTempState& st, 
+                                   const KGrid& grid, int begin, int end, 
+                                   double *sums);
     // term summed to calculate Re Pi (xx, xy, yy)
-    static double innerPiCommon(const InnerPiInput& ipi, double qx, double qy);
-    static double innerPiXX(const InnerPiInput& ipi, double qx, double qy);
-    static double innerPiXY(const InnerPiInput& ipi, double qx, double qy);
-    static double innerPiYY(const InnerPiInput& ipi, double qx, double qy);
-    // BZone call required to calculate these.
+    static double innerPiCommon(const InnerPiInput& ipi, const KPoint& q);
+    static double innerPiXX(const InnerPiInput& ipi, const KPoint& q);
+    static double innerPiXY(const InnerPiInput& ipi, const KPoint& q);
+    static double innerPiYY(const InnerPiInput& ipi, const KPoint& q);
+    // all three at once, sharing innerPiCommon: terms = {xx, xy, yy}
+    static void innerPiAll(const InnerPiInput& ipi, const KPoint& q,
+                           double *terms);
+    // Weighted sums of innerPiAll's terms over grid points [begin, end).
+    static void innerPiBatch(const InnerPiInput& ipi, const KGrid& grid,
+                             int begin, int end, double *sums);
+    // The same for each of ipn.omegas: sums[3 * i + c], sharing
+    // the omega-independent factors.
+    static void innerPiNodesBatch(const InnerPiNodesInput& ipn, 
+                                  const KGrid& grid, int begin, int end, 
+                                  double *sums);
+    // innerPiBatch's sums in sums[0-2] and their omega derivatives in 
+    // sums[3-5], from the same pass.
+    static void innerPiDerivBatch(const InnerPiInput& ipi, 
+                                  const KGrid& grid, int begin, int end,
+                                  double *sums);
+    // BZone call required to calculate these.  getPi makes one pass over
+    // the grid for all of Pi's components, using innerPiBatch unless 
+    // env.kernelMode is "scalar".  Pi is even in q, so the batch sum only
+    // visits half the grid.
     static double getLambda(double omega, void *params);
     static PiOutput getPi(const CritTempState& st, double omega, 
                           double kx, double ky);
+    // Pi at each of omegas in one pass: component c at omegas[i] goes in
+    // out[3 * i + c].
+    static void getPiNodes(const CritTempState& st, 
+                           const std::vector<double>& omegas, 
+                           double kx, double ky, double *out);
+    // Pi at every k = 4 pi (mx, my) / N with 0 <= mx, my < N / 2, where
+    // N is the (even) side of the full grid, by FFT in O(N^2 log N): 
+    // component c at (mx, my) goes in out[3 * (my * N / 2 + mx) + c].
+    // These are the k for which q + k/2 is on the grid, so each is the sum
+    // getPi does.  omega has to be below the smallest 
+    // xi(q + k/2) + xi(q - k/2); otherwise logs an error and returns false.
+    static bool getPiGrid(const CritTempState& st, double omega,
+                          std::vector<double>& out);
+    // Pi in out[0-2] and dPi/domega in out[3-5], in one pass.
+    static void getPiDeriv(const CritTempState& st, double omega, 
+                           double kx, double ky, double *out);
+    // The part of getLambda after Pi is known.
+    static double lambdaFromPi(const LambdaInput& lin, const PiOutput& Pi);
+    // dLambda/domega from Pi and dPi/domega.
+    static double lambdaDerivFromPi(const LambdaInput& lin, 
+                                    const PiOutput& Pi, 
+                                    const PiOutput& dPi);
+    // Lambda at omega, with dLambda/domega stored in dLambda; one pass.
+    static double getLambdaDeriv(const LambdaInput& lin, double omega, 
+                                 double *dLambda);
+    // Pi and Lambda from a PiTable (params is a PiTable*).
+    static PiOutput tablePi(const PiTable& table, double omega);
+    static double tableLambda(double omega, void *params);
     // Requires solving for omega coefficients.  bc = (nu/x2)^(2/3)
     static double nuFunction(double y, void *params);
-    static double getNu(const CritTempState& st);
-    // Requires finding the smallest root of lambda minus or plus.
+    // The integral of nuFunction from 0 to a, to about machine precision.
+    static double boseIntegral(double a);
+    // With more than one thread and root solves to do, the pieces run as 
+    // OpenMP tasks, with timings in the debug log.  The integral uses 
+    // boseIntegral, or Integrator if env.nuIntegralMode is "integrator".
+    // The omega coefficients used are stored in ocsOut if it's not NULL.
+    static double getNu(const CritTempState& st, OmegaCoeffs *ocsOut = NULL);
+    // Picks one of the below per env.omegaCoeffsMode.  The expansion 
+    // needs mu < 0; otherwise the root solves are used.
     static OmegaCoeffs getOmegaCoeffs(const CritTempState& st);
+    // Requires finding the smallest root of lambda minus or plus.  The 
+    // three solves are independent tasks, each with a third of 
+    // env.numThreads for its grid passes.
+    static OmegaCoeffs rootOmegaCoeffs(const CritTempState& st);
+    // Expand Lambda minus about k = 0, omega = 0 (where it vanishes at Tc):
+    // Lambda ~ lambda0 + dOmega omega + (quadratic in k), so omega(k) is 
+    // the quadratic over -dOmega.  Pi's derivatives all come from one 
+    // grid pass.  lambda0 and dOmega are stored if not NULL.
+    static OmegaCoeffs expandOmegaCoeffs(const CritTempState& st, 
+                                         double *lambda0 = NULL, 
+                                         double *dOmega = NULL);
+    // Sums over grid points [begin, end) for expandOmegaCoeffs, at k = 0
+    // and omega = 0: Pi's xx, xy, yy components in sums[0-2], their 
+    // omega derivatives in sums[3-5], and in sums[6 + 3 a + b] the 
+    // coefficient of k^T Q k in component a, for Q's xx, xy, yy element b.
+    static void piExpansionBatch(const CritTempState& st, const KGrid& grid,
+                                 int begin, int end, double *sums);
     // Use this to check accuracy of OmegaCoeffs.
     static double omegaApprox(const OmegaCoeffs& oc, double kx, double ky, 
                               double kz);
-    // Required to find root of lambda.
+    // Required to find root of lambda.  With env.omegaRootMode "table" or
+    // "newton", omegaFromTable or omegaNewton is tried first.
     static double omegaExact(const CritTempState& st, double kx, double ky, 
                              double kz);
+    // Find the root of Lambda on a PiTable, then check with two exact 
+    // evaluations that Lambda changes sign within OMEGA_ROOT_TOL of it.
+    // Returns -1 if there's no root on the table or it doesn't check out.
+    static double omegaFromTable(const CritTempState& st, double kx, 
+                                 double ky, double kz);
+    // Newton's method on Lambda from omega = 0, inside [0, -2 mu] where Pi
+    // has no poles.  Once Lambda has changed sign, steps that leave the 
+    // bracket are replaced by bisection; before that, returns -1 so the
+    // bracketing search can take over.
+    static double omegaNewton(const CritTempState& st, double kx, 
+                              double ky, double kz);
 };
 
 #endif
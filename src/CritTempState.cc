@@ -20,8 +20,14 @@
   THE SOFTWARE.
 */
 
+#include <algorithm>
+
 #include "CritTempState.hh"
 
+NuCache::NuCache() : valid(false), hasNu(false), gridLen(0), d1(0.0), 
+    mu(0.0), bc(0.0), nu(0.0), planar(0.0), perp(0.0), cross(0.0), hits(0),
+    misses(0) { }
+
 CritTempState::CritTempState(const CritTempEnvironment& envIn) : 
     BaseState(envIn), env(envIn), bc(envIn.initBc) 
 {   
@@ -29,21 +35,79 @@ CritTempState::CritTempState(const CritTempEnvironment& envIn) :
 }
 
 // driver
-bool CritTempState::makeSelfConsistent() {
-    do {
+bool CritTempState::solve() {
+    if (env.solverMode == "coupled") {
+        if (fixCoupled() && checkSelfConsistent()) {
+            return true;
+        }
+        env.errorLog.printf("Coupled solve failed, using nested solve.\n");
+    }
+    std::vector<double> weights(3);
+    weights[0] = 1.0 / env.tolD1;
+    weights[1] = 1.0 / env.tolMu;
+    weights[2] = 1.0 / env.tolBc;
+    AndersonMixer mixer(3, env.andersonDepth, weights);
+    outerIterations = 0;
+    startPrecision();
+    bool converged = false;
+    while (!converged && outerIterations < outerMaxIters) {
+        std::vector<double> start(3);
+        start[0] = d1;
+        start[1] = mu;
+        start[2] = bc;
         fixD1();
         env.debugLog.printf("got d1 = %e\n", d1);
         fixMu();
         env.debugLog.printf("got mu = %e\n", mu);
         fixBc();
         env.debugLog.printf("got bc = %e\n", bc);
-    } while (!checkSelfConsistent());
-    return checkSelfConsistent();
+        outerIterations++;
+        // Check before mixing: the mixed values don't each solve their own
+        // equation the way the plain step's values do.
+        // Errors from the single-precision kernels can't show convergence.
+        converged = !lowPrecision && checkSelfConsistent();
+        if (lowPrecision) {
+            updatePrecision(maxScaledError(), &CritTempState::gridTerms, 3);
+        }
+        if (!converged && env.mixingMode == "anderson") {
+            std::vector<double> step(3);
+            step[0] = d1;
+            step[1] = mu;
+            step[2] = bc;
+            const std::vector<double> next = mixer.mix(start, step);
+            if (next[2] > 0.0 && next[1] < 0.0) {
+                d1 = next[0];
+                mu = next[1];
+                bc = next[2];
+                setEpsilonMin();
+                env.debugLog.printf("mixed to d1 = %e, mu = %e, bc = %e\n",
+                                    d1, mu, bc);
+            } else {
+                // Mixed values are out of range; keep the plain step.
+                mixer.reset();
+            }
+        }
+    }
+    lowPrecision = false;
+    if (!converged) {
+        env.errorLog.printf("Outer loop failed to converge!\n");
+    }
+    const int plainIterations = mixer.estimatePlainSteps();
+    outerIterationsSaved = plainIterations > outerIterations ? 
+                           plainIterations - outerIterations : 0;
+    env.debugLog.printf("outer iterations = %d, saved by mixing = %d\n", 
+                        outerIterations, outerIterationsSaved);
+    return converged;
 }
 
 // checkers
 bool CritTempState::checkSelfConsistent() const {
-    return checkD1() && checkMu() && checkBc();
+    return checkSelfConsistent(absErrors());
+}
+
+bool CritTempState::checkSelfConsistent(const CritTempErrors& errors) const {
+    return fabs(errors.d1) < env.tolD1 && fabs(errors.mu) < env.tolMu
+        && fabs(errors.bc) < env.tolBc;
 }
 
 bool CritTempState::checkBc() const {
@@ -53,45 +117,115 @@ bool CritTempState::checkBc() const {
 // error calculators
 double CritTempState::absErrorD1() const {
     double lhs = d1;
-    double rhs = BZone::average<CritTempState>(*this, *this, 
-                                               CritTempSpectrum::innerD1);
+    double rhs;
+    if (separateSums()) {
+        rhs = BZone::average<CritTempState>(*this, *this, 
+                                            CritTempSpectrum::innerD1,
+                                            termSymmetry());
+    } else {
+        double terms[3];
+        averageTerms(terms);
+        rhs = terms[0];
+    }
     return lhs - rhs;
 }
 
 double CritTempState::absErrorMu() const {
     double lhs = 1.0 / (env.t0 + env.tz);
-    double rhs = BZone::average<CritTempState>(*this, *this,
-                                               CritTempSpectrum::innerMu);
+    double rhs;
+    if (separateSums()) {
+        rhs = BZone::average<CritTempState>(*this, *this, 
+                                            CritTempSpectrum::innerMu,
+                                            termSymmetry());
+    } else {
+        double terms[3];
+        averageTerms(terms);
+        rhs = terms[1];
+    }
     return lhs - rhs;
 }
 
 double CritTempState::absErrorBc() const {
-    double nu = CritTempSpectrum::getNu(*this);
+    double nu = getNu();
     double rhs = pow(nu / getX2(), 2.0 / 3.0);
 
     double lhs = bc;
     return lhs - rhs;
 }
 
+void CritTempState::averageTerms(double *rhs, double *discError) const {
+    if (env.bzoneIntegrator == "adaptive") {
+        noteAdaptive(AdaptiveBZone::averages<CritTempState>(*this, *this, 
+            CritTempSpectrum::innerAll, 3, rhs, discError, termSymmetry()));
+        return;
+    }
+    extrapolateTerms(&CritTempState::gridTerms, 3, rhs, discError);
+}
+
+void CritTempState::gridTerms(const BaseState& stBase, double *rhs) {
+    const CritTempState& st = (const CritTempState&)stBase;
+    if (st.env.kernelMode == "scalar") {
+        BZone::averages<CritTempState>(st, st, CritTempSpectrum::innerAll, 3, 
+                                       rhs, st.termSymmetry());
+    } else if (st.lowPrecision) {
+        BZone::averagesBatch<CritTempState>(st, st, 
+            CritTempSpectrum::innerAllBatchFloat, 3, rhs, st.termSymmetry());
+    } else {
+        BZone::averagesBatch<CritTempState>(st, st, 
+            CritTempSpectrum::innerAllBatch, 3, rhs, st.termSymmetry());
+    }
+}
+
+CritTempErrors CritTempState::absErrors(double *discError) const {
+    double rhs[3];
+    averageTerms(rhs, discError);
+    CritTempErrors errors;
+    errors.d1 = d1 - rhs[0];
+    errors.mu = 1.0 / (env.t0 + env.tz) - rhs[1];
+    double nu = getNu();
+    errors.bc = bc - pow(nu / (env.x - rhs[2]), 2.0 / 3.0);
+    return errors;
+}
+
+// The bc equation is left out: its error needs getNu, which is expensive 
+// and doesn't use the batch kernels.
+double CritTempState::maxScaledError() const {
+    double rhs[3];
+    averageTerms(rhs);
+    return std::max(fabs(d1 - rhs[0]) / env.tolD1, 
+                    fabs(1.0 / (env.t0 + env.tz) - rhs[1]) / env.tolMu);
+}
+
 double CritTempState::relErrorD1() const {
-    double error = absErrorD1();
+    return relErrorD1(absErrorD1());
+}
+
+double CritTempState::relErrorD1(double error) const {
     if (d1 == 0.0 && error == 0.0) {
         return 0.0;
     }
     else if (d1 == 0.0) {
-        return fabs(d1) / fabs(absErrorD1());
+        return fabs(d1) / fabs(error);
     }
     else {
-        return fabs(absErrorD1()) / fabs(d1);
+        return fabs(error) / fabs(d1);
     }
 }
 
 double CritTempState::relErrorMu() const {
-    return fabs(absErrorMu()) * (env.t0 + env.tz);
+    return relErrorMu(absErrorMu());
+}
+
+double CritTempState::relErrorMu(double error) const {
+    return fabs(error) * (env.t0 + env.tz);
 }
 
 double CritTempState::relErrorBc() const {
-    return fabs(absErrorBc()) / bc;
+    return relErrorBc(absErrorBc());
+}
+
+double CritTempState::relErrorBc(double error) const {
+    return fabs(error) / bc;
 }
 
 // getters
@@ -100,30 +234,129 @@ double CritTempState::getBc() const {
 }
 
 double CritTempState::getX1() const {
-    return BZone::average<CritTempState>(*this, *this,
-                                         CritTempSpectrum::innerX1);
+    if (separateSums()) {
+        return BZone::average<CritTempState>(*this, *this,
+                                             CritTempSpectrum::innerX1,
+                                             termSymmetry());
+    }
+    double terms[3];
+    averageTerms(terms);
+    return terms[2];
 }
 
 double CritTempState::getX2() const {
     return env.x - getX1();
 }
 
+double CritTempState::getNu() const {
+    if (nuCacheMatches() && nuCache.hasNu) {
+        nuCache.hits++;
+        return nuCache.nu;
+    }
+    nuCache.misses++;
+    OmegaCoeffs ocs;
+    const double nu = CritTempSpectrum::getNu(*this, &ocs);
+    storeNuCache(ocs);
+    nuCache.nu = nu;
+    nuCache.hasNu = true;
+    return nu;
+}
+
+OmegaCoeffs CritTempState::getOmegaCoeffs() const {
+    if (nuCacheMatches()) {
+        nuCache.hits++;
+    } else {
+        nuCache.misses++;
+        storeNuCache(CritTempSpectrum::getOmegaCoeffs(*this));
+    }
+    OmegaCoeffs ocs;
+    ocs.planar = nuCache.planar;
+    ocs.perp = nuCache.perp;
+    ocs.cross = nuCache.cross;
+    return ocs;
+}
+
+const NuCache& CritTempState::getNuCache() const {
+    return nuCache;
+}
+
+// The key isn't moved on a hit, so reuse can't drift further than the 
+// tolerance from where the values were computed.
+bool CritTempState::nuCacheMatches() const {
+    return nuCache.valid && nuCache.gridLen == gridLen
+        && fabs(d1 - nuCache.d1) <= env.nuCacheTol * env.tolD1
+        && fabs(mu - nuCache.mu) <= env.nuCacheTol * env.tolMu
+        && fabs(bc - nuCache.bc) <= env.nuCacheTol * env.tolBc * bc;
+}
+
+void CritTempState::storeNuCache(const OmegaCoeffs& ocs) const {
+    nuCache.valid = true;
+    nuCache.hasNu = false;
+    nuCache.gridLen = gridLen;
+    nuCache.d1 = d1;
+    nuCache.mu = mu;
+    nuCache.bc = bc;
+    nuCache.planar = ocs.planar;
+    nuCache.perp = ocs.perp;
+    nuCache.cross = ocs.cross;
+}
+
 // logging
 void CritTempState::logState() const {
-    std::string sc = checkSelfConsistent() ? "true" : "false";
+    double discError[3];
+    const CritTempErrors errors = absErrors(discError);
+    std::string sc = checkSelfConsistent(errors) ? "true" : "false";
     env.outputLog.printf("<begin>,state\n");
     env.outputLog.printf("self-consistent,%s\n", sc.c_str());
-    env.outputLog.printf("d1,%e\nd1RelError,%e\n", getD1(), relErrorD1());
-    env.outputLog.printf("mu,%e\nmuRelError,%e\n", getMu(), relErrorMu());
-    env.outputLog.printf("bc,%e\nbcRelError,%e\n", getBc(), relErrorBc());
+    env.outputLog.printf("d1,%e\nd1RelError,%e\n", getD1(), 
+                         relErrorD1(errors.d1));
+    env.outputLog.printf("mu,%e\nmuRelError,%e\n", getMu(), 
+                         relErrorMu(errors.mu));
+    env.outputLog.printf("bc,%e\nbcRelError,%e\n", getBc(), 
+                         relErrorBc(errors.bc));
+    if (env.extrapolationLevels > 1) {
+        env.outputLog.printf("d1DiscError,%e\nmuDiscError,%e\n"
+                             "x1DiscError,%e\n", discError[0], 
+                             discError[1], discError[2]);
+    }
+    if (env.bzoneIntegrator == "adaptive") {
+        logAdaptive();
+    }
+    if (env.precisionMode == "mixed") {
+        env.outputLog.printf("precisionSwitchIteration,%d\n"
+                             "floatSumError,%e\n", precisionSwitchIteration,
+                             floatSumError);
+    }
+    env.outputLog.printf("outerIterations,%d\nouterIterationsSaved,%d\n",
+                         outerIterations, outerIterationsSaved);
+    env.outputLog.printf("nuCacheHits,%d\nnuCacheMisses,%d\n", 
+                         nuCache.hits, nuCache.misses);
     env.outputLog.printf("<end>,state\n");
 }
 
+// lockstep solving
+int CritTempState::numVariables() const {
+    return 3;
+}
+
+void CritTempState::getVariables(double *vars) const {
+    vars[0] = d1;
+    vars[1] = mu;
+    vars[2] = bc;
+}
+
+void CritTempState::setVariables(const double *vars) {
+    d1 = vars[0];
+    mu = vars[1];
+    bc = vars[2];
+    setEpsilonMin();    // D1 changed so epsilonMin might change
+}
+
 // variable manipulators
-double CritTempState::setEpsilonMin() {
-    epsilonMin = BZone::minimum<CritTempState>(*this, *this, 
-                                               CritTempSpectrum::epsilonBar);
-    return epsilonMin;
+double CritTempState::gridEpsilonMin() const {
+    return BZone::minimum<CritTempState>(*this, *this, 
+                                     CritTempSpectrum::epsilonBar,
+                                     termSymmetry());
 }
 
 double CritTempState::helperD1(double x, void *params) {
@@ -146,6 +379,8 @@ bool CritTempState::fixD1() {
     double old_d1 = d1;
     RootFinder rootFinder(&CritTempState::helperD1, this, d1, 
                           0.0, 1.0, env.tolD1 / 10);
+    CoarseBracket coarse(this, &CritTempState::helperD1, this);
+    setCoarseBracket(rootFinder, coarse);
     const RootData& rootData = rootFinder.findRoot();
     if (!rootData.converged) {
         env.errorLog.printf("D1 failed to converge!\n");
@@ -159,6 +394,8 @@ bool CritTempState::fixMu() {
     double old_mu = mu;
     RootFinder rootFinder(&CritTempState::helperMu, this, mu, 
                           -1.0, 0.0, env.tolMu / 10);
+    CoarseBracket coarse(this, &CritTempState::helperMu, this);
+    setCoarseBracket(rootFinder, coarse);
     const RootData& rootData = rootFinder.findRoot();
     if (!rootData.converged) {
         env.errorLog.printf("Mu failed to converge!\n");
@@ -169,19 +406,93 @@ bool CritTempState::fixMu() {
 }
 
 bool CritTempState::fixBc() {
-    double old_bc = bc, last_bc = bc;
+    double old_bc = bc;
+    // With mixing on, every second step jumps to the Aitken extrapolate of
+    // the last three iterates (Steffensen's method).
+    double aitken_bc0 = bc, aitken_bc1 = bc;
+    int plainSteps = 0;
     for (int iterCount = 0; iterCount < BC_MAX_ITERS; iterCount++) {
         fixMu();
         env.debugLog.printf("mu fixed at %e\n", mu);
-        double nu = CritTempSpectrum::getNu(*this);
-        env.debugLog.printf("nu = %e, x2 = %e\n", nu, getX2());
-        bc = pow(nu / getX2(), 2.0 / 3.0);
-        env.debugLog.printf("setting bc to %e\n", bc);
-        if (fabs(bc - last_bc) / bc < env.tolBc) {
+        double nu = getNu();
+        double x2 = getX2();
+        env.debugLog.printf("nu = %e, x2 = %e\n", nu, x2);
+        double next_bc = pow(nu / x2, 2.0 / 3.0);
+        env.debugLog.printf("next bc is %e\n", next_bc);
+        if (fabs(next_bc - bc) / next_bc < env.tolBc) {
+            bc = next_bc;
             return true;
         }
+        if (env.mixingMode == "anderson") {
+            plainSteps++;
+            if (plainSteps == 1) {
+                aitken_bc0 = bc;
+                aitken_bc1 = next_bc;
+            } else {
+                double extrap_bc = AndersonMixer::aitken(aitken_bc0, 
+                                                         aitken_bc1, next_bc);
+                if (gsl_finite(extrap_bc) && extrap_bc > 0.0) {
+                    next_bc = extrap_bc;
+                }
+                plainSteps = 0;
+            }
+        }
+        bc = next_bc;
+        env.debugLog.printf("setting bc to %e\n", bc);
     }
     env.errorLog.printf("Bc failed to converge!\n");
     bc = old_bc;
     return false;
 }
+
+// Residuals are scaled by their tolerances so that every variable counts the
+// same in the solver's convergence test.
+int CritTempState::helperCoupled(const gsl_vector *x, void *params, 
+                                 gsl_vector *f) {
+    CritTempState *st = (CritTempState*)params;
+    st->d1 = gsl_vector_get(x, 0);
+    st->mu = gsl_vector_get(x, 1);
+    st->bc = gsl_vector_get(x, 2);
+    if (st->bc <= 0.0 || st->mu >= 0.0) {
+        return GSL_EDOM;
+    }
+    st->setEpsilonMin();    // D1 changed so epsilonMin might change
+    const CritTempErrors errors = st->absErrors();
+    gsl_vector_set(f, 0, errors.d1 / st->env.tolD1);
+    gsl_vector_set(f, 1, errors.mu / st->env.tolMu);
+    gsl_vector_set(f, 2, errors.bc / st->env.tolBc);
+    st->env.debugLog.printf("coupled trial d1 = %e, mu = %e, bc = %e\n", 
+                            st->d1, st->mu, st->bc);
+    if (!(gsl_finite(gsl_vector_get(f, 0)) && gsl_finite(gsl_vector_get(f, 1))
+          && gsl_finite(gsl_vector_get(f, 2)))) {
+        return GSL_EBADFUNC;
+    }
+    return GSL_SUCCESS;
+}
+
+bool CritTempState::fixCoupled() {
+    double old_d1 = d1, old_mu = mu, old_bc = bc;
+    std::vector<double> guess(3);
+    guess[0] = d1;
+    guess[1] = mu;
+    guess[2] = bc;
+    MultiRootFinder rootFinder(&CritTempState::helperCoupled, this, guess, 0.1);
+    const MultiRootData& rootData = rootFinder.findRoot();
+    if (!rootData.converged) {
+        env.errorLog.printf("Coupled solve failed to converge after %d "
+                            "iterations!\n", rootData.iterations);
+        d1 = old_d1;
+        mu = old_mu;
+        bc = old_bc;
+        setEpsilonMin();
+        return false;
+    }
+    d1 = rootData.root[0];
+    mu = rootData.root[1];
+    bc = rootData.root[2];
+    setEpsilonMin();
+    env.debugLog.printf("coupled solve got d1 = %e, mu = %e, bc = %e "
+                        "in %d iterations\n", d1, mu, bc, 
+                        rootData.iterations);
+    return true;
+}
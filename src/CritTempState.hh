@@ -28,14 +28,31 @@
 #include "BaseState.hh"
 #include "CritTempEnvironment.hh"
 #include "RootFinder.hh"
+#include "MultiRootFinder.hh"
+#include "AndersonMixer.hh"
+
+// Absolute errors in all the S-C equations.  d1 and mu (and x1, needed for
+// bc) come from one BZone pass.
+struct CritTempErrors {
+    double d1, mu, bc;
+};
+
+struct OmegaCoeffs;
+
+// The last omega coefficients (and nu, if hasNu) computed, the d1, mu, bc 
+// and gridLen they were computed at, and how often they were reused.
+struct NuCache {
+    NuCache();
+    bool valid, hasNu;
+    int gridLen;
+    double d1, mu, bc, nu, planar, perp, cross;
+    int hits, misses;
+};
 
 class CritTempState : public BaseState {
 public:
     // Constructor needs to examine envIn to set member variables.
     CritTempState(const CritTempEnvironment& envIn);
-    // Drive calculations needed to make this State consistent
-    // with the given Environment.  Return false if unable to converge.
-    bool makeSelfConsistent();
     // Return true is the errors in all self-consistent equations are within
     // their tolerances, false otherwise.
     bool checkSelfConsistent() const;
@@ -46,6 +63,14 @@ public:
     double absErrorD1() const;
     double absErrorMu() const;
     double absErrorBc() const;
+    // All of the above at once.  discError is passed on to averageTerms.
+    CritTempErrors absErrors(double *discError = NULL) const;
+    // Averages of the three S-C sums (CritTempSpectrum::innerAll's terms),
+    // evaluated with the kernels picked by env.kernelMode and extrapolated
+    // over grid sizes per env.extrapolationLevels, or integrated 
+    // adaptively if env.bzoneIntegrator says so.  If discError is not NULL
+    // it gets each sum's estimated discretization (or cubature) error.
+    void averageTerms(double *rhs, double *discError = NULL) const;
     // Relative error
     double relErrorD1() const;
     double relErrorMu() const;
@@ -55,10 +80,21 @@ public:
     // BZone call required to calculate these.
     double getX1() const;
     double getX2() const; // x2 = x - x1
+    // CritTempSpectrum's getNu and getOmegaCoeffs, reusing the last 
+    // result while d1 and mu stay within env.nuCacheTol times their 
+    // tolerances of where it was computed, and bc within nuCacheTol * tolBc
+    // relative to it.
+    double getNu() const;
+    OmegaCoeffs getOmegaCoeffs() const;
+    const NuCache& getNuCache() const;
     // Need to know accuracy of omega_k approximation.
     void logOmegaAccuracy() const;
     // Output what state is now.
     void logState() const;
+    // Lockstep solving support; see BaseState.
+    int numVariables() const;
+    void getVariables(double *vars) const;
+    void setVariables(const double *vars);
      // RootFinder needs to be a friend to do its dirty work.
     friend class RootFinder;
     // Our Environment, containing all the configuration info we need.
@@ -66,9 +102,20 @@ public:
 protected:
     // Self-consistent variables.
     double bc;
-    // Set epsilonMin to the appropriate value.
-    // -- Need to call this after changing D1! --
-    double setEpsilonMin();
+    mutable NuCache nuCache;
+    // True if nuCache can be used at the current variables.
+    bool nuCacheMatches() const;
+    // Key nuCache to the current variables and store ocs in it.
+    void storeNuCache(const OmegaCoeffs& ocs) const;
+    // Largest |error| / tolerance among the S-C equations.
+    double maxScaledError() const;
+    // Versions of the public checkers which reuse already-computed errors.
+    bool checkSelfConsistent(const CritTempErrors& errors) const;
+    double relErrorD1(double error) const;
+    double relErrorMu(double error) const;
+    double relErrorBc(double error) const;
+    // Minimum of epsilonBar over the grid points.
+    double gridEpsilonMin() const;
     // Set the variable to the value which minimizes the error in the
     // associated self-consistent equation. Return value found.
     // Note: d1 and mu equations are coupled, so they must be iterated 
@@ -76,14 +123,24 @@ protected:
     bool fixD1();
     bool fixMu();
     bool fixBc();
+    // Solve for d1, mu and bc together as one coupled system.  If that
+    // doesn't converge, restore the old values and return false.
+    bool fixCoupled();
+    // Solve at the current gridLen, coupled or nested per env.solverMode.
+    bool solve();
+    // The three S-C sums on stBase's current gridLen, for extrapolateTerms.
+    static void gridTerms(const BaseState& stBase, double *rhs);
     // Functions to be passed into RootFinder
     static double helperD1(double x, void *params);
     static double helperMu(double x, void *params);
+    static int helperCoupled(const gsl_vector *x, void *params, 
+                             gsl_vector *f);
 };
 
 // these are #included down here because they refer to State; should have it
 // declared before including them
 #include "CritTempSpectrum.hh"
 #include "BZone.hh" 
+#include "AdaptiveBZone.hh"
 
 #endif
@@ -0,0 +1,56 @@
+/*
+  Copyright (c) 2011 Timothy Lovorn
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include "FFT2D.hh"
+
+FFT2D::FFT2D(int _n) : n(_n) {
+    myWavetable = gsl_fft_complex_wavetable_alloc(n);
+    myWorkspace = gsl_fft_complex_workspace_alloc(n);
+}
+
+FFT2D::~FFT2D() {
+    gsl_fft_complex_workspace_free(myWorkspace);
+    gsl_fft_complex_wavetable_free(myWavetable);
+}
+
+// Rows are contiguous; columns have stride n.
+void FFT2D::forward(double *data) {
+    for (int iy = 0; iy < n; iy++) {
+        gsl_fft_complex_forward(data + 2 * iy * n, 1, n, myWavetable, 
+                                myWorkspace);
+    }
+    for (int ix = 0; ix < n; ix++) {
+        gsl_fft_complex_forward(data + 2 * ix, n, n, myWavetable, 
+                                myWorkspace);
+    }
+}
+
+void FFT2D::backward(double *data) {
+    for (int iy = 0; iy < n; iy++) {
+        gsl_fft_complex_backward(data + 2 * iy * n, 1, n, myWavetable, 
+                                 myWorkspace);
+    }
+    for (int ix = 0; ix < n; ix++) {
+        gsl_fft_complex_backward(data + 2 * ix, n, n, myWavetable, 
+                                 myWorkspace);
+    }
+}
@@ -0,0 +1,50 @@
+/*
+  Copyright (c) 2011 Timothy Lovorn
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#ifndef __SCSS_FFT_2D_H
+#define __SCSS_FFT_2D_H
+
+#include <gsl/gsl_errno.h>
+#include <gsl/gsl_fft_complex.h>
+
+// Complex FFTs of an n by n grid, stored row by row as (re, im) pairs: 
+// element (ix, iy) is data[2 * (iy * n + ix)] and the one after.  Rows 
+// and columns are done with GSL's mixed-radix transforms, so n needn't be
+// a power of 2.  Not safe to share between threads (one workspace).
+class FFT2D {
+public:
+    FFT2D(int _n);
+    ~FFT2D();
+    // In place.  forward uses exp(-2 pi i (jx mx + jy my) / n); backward 
+    // uses exp(+...), unnormalized, so backward(forward(x)) = n^2 x.
+    void forward(double *data);
+    void backward(double *data);
+    const int n;
+private:
+    // Copying would free the GSL tables twice.
+    FFT2D(const FFT2D& other);
+    FFT2D& operator=(const FFT2D& other);
+    gsl_fft_complex_wavetable *myWavetable;
+    gsl_fft_complex_workspace *myWorkspace;
+};
+
+#endif
@@ -22,6 +22,31 @@
 
 #include "Integrator.hh"
 
+// Free workspaces of the calling thread, made on its first request.
+static std::vector<gsl_integration_workspace*> *freeWorkspaces = NULL;
+#pragma omp threadprivate(freeWorkspaces)
+
+static int numWorkspaces = 0;
+
+// Wraps the integrand to count its evaluations.
+struct CountedFunction {
+    const gsl_function *function;
+    int evaluations;
+};
+
+static double countedEval(double x, void *params) {
+    CountedFunction *counted = (CountedFunction*)params;
+    counted->evaluations++;
+    return GSL_FN_EVAL(counted->function, x);
+}
+
+IntegralResult::IntegralResult() : value(0.0), error(0.0), evaluations(0),
+    converged(false) { }
+
+IntegralSpec::IntegralSpec(double (*_integrand)(double, void*), 
+                           void *_params, double _left, double _right) :
+    integrand(_integrand), params(_params), left(_left), right(_right) { }
+
 Integrator::Integrator(double (*const integrand)(double, void*), 
                        void * const params, 
                        double _absTolerance, double _relTolerance) : 
@@ -29,17 +54,100 @@ Integrator::Integrator(double (*const integrand)(double, void*),
 {
     myFunction.function = integrand;
     myFunction.params = params;
-    myWorkspace = gsl_integration_workspace_alloc(WS_SIZE);
+    myWorkspace = acquireWorkspace();
 }
 
 Integrator::~Integrator() {
-    gsl_integration_workspace_free(myWorkspace);
+    releaseWorkspace(myWorkspace);
 }
 
 double Integrator::doIntegral(double leftBound, double rightBound, 
                               const Logger& errorLog) {
-    double result, error;
-    gsl_integration_qags(&myFunction, leftBound, rightBound, absTolerance,
-        relTolerance, WS_SIZE, myWorkspace, &result, &error);
+    const IntegralResult result = integrate(leftBound, rightBound);
+    if (!result.converged) {
+        errorLog.printf("Integral from %e to %e = %e not converged, error "
+                        "estimate %e after %d evaluations\n", leftBound,
+                        rightBound, result.value, result.error, 
+                        result.evaluations);
+    }
+    return result.value;
+}
+
+void Integrator::integrateBatch(const std::vector<IntegralSpec>& specs,
+                                double absTolerance, double relTolerance,
+                                bool smooth, int numThreads,
+                                std::vector<IntegralResult>& results) {
+    const int numSpecs = specs.size();
+    results.assign(numSpecs, IntegralResult());
+    #pragma omp parallel for num_threads(numThreads) schedule(dynamic)
+    for (int i = 0; i < numSpecs; i++) {
+        Integrator integrator(specs[i].integrand, specs[i].params, 
+                              absTolerance, relTolerance);
+        if (smooth) {
+            results[i] = integrator.integrateSmooth(specs[i].left, 
+                                                    specs[i].right);
+        } else {
+            results[i] = integrator.integrate(specs[i].left, specs[i].right);
+        }
+    }
+}
+
+int Integrator::workspacesAllocated() {
+    int count;
+    #pragma omp atomic read
+    count = numWorkspaces;
+    return count;
+}
+
+IntegralResult Integrator::integrate(double leftBound, double rightBound) {
+    CountedFunction counted = {&myFunction, 0};
+    gsl_function function;
+    function.function = &countedEval;
+    function.params = &counted;
+    IntegralResult result;
+    const int status = gsl_integration_qags(&function, leftBound, rightBound,
+        absTolerance, relTolerance, WS_SIZE, myWorkspace, &result.value, 
+        &result.error);
+    result.evaluations = counted.evaluations;
+    result.converged = status == GSL_SUCCESS;
+    return result;
+}
+
+IntegralResult Integrator::integrateSmooth(double leftBound, 
+                                           double rightBound) {
+    IntegralResult result;
+    size_t evaluations;
+    const int status = gsl_integration_qng(&myFunction, leftBound, 
+        rightBound, absTolerance, relTolerance, &result.value, 
+        &result.error, &evaluations);
+    if (status == GSL_SUCCESS) {
+        result.evaluations = evaluations;
+        result.converged = true;
+        return result;
+    }
+    result = integrate(leftBound, rightBound);
+    result.evaluations += evaluations;
     return result;
 }
+
+gsl_integration_workspace *Integrator::acquireWorkspace() {
+    if (freeWorkspaces == NULL) {
+        freeWorkspaces = new std::vector<gsl_integration_workspace*>;
+    }
+    if (freeWorkspaces->empty()) {
+        #pragma omp atomic
+        numWorkspaces++;
+        return gsl_integration_workspace_alloc(WS_SIZE);
+    }
+    gsl_integration_workspace *workspace = freeWorkspaces->back();
+    freeWorkspaces->pop_back();
+    return workspace;
+}
+
+// Kept for the life of the thread; OpenMP reuses its threads.
+void Integrator::releaseWorkspace(gsl_integration_workspace *workspace) {
+    if (freeWorkspaces == NULL) {
+        freeWorkspaces = new std::vector<gsl_integration_workspace*>;
+    }
+    freeWorkspaces->push_back(workspace);
+}
@@ -20,9 +20,12 @@
   THE SOFTWARE.
 */
 
+
 #ifndef __SCSS_INTEGRATOR_HH
 #define __SCSS_INTEGRATOR_HH
 
+#include <vector>
+
 #include <gsl/gsl_errno.h>
 #include <gsl/gsl_integration.h>
 
@@ -30,14 +33,58 @@
 
 #define WS_SIZE 10000 // size allocated for gsl workspace
 
+// One integral's value, GSL's estimate of its absolute error, how many 
+// times the integrand was evaluated, and whether the tolerances were met.
+struct IntegralResult {
+    IntegralResult();
+    double value, error;
+    int evaluations;
+    bool converged;
+};
+
+// One integral of a batch: integrand(x, params) from left to right.
+struct IntegralSpec {
+    IntegralSpec(double (*_integrand)(double, void*), void *_params,
+                 double _left, double _right);
+    double (*integrand)(double, void*);
+    void *params;
+    double left, right;
+};
+
+// Failures are only reported through IntegralResult if GSL's default error
+// handler, which aborts, was switched off at startup.  Every program using
+// Integrator, directly or through a State's solve, must call 
+// gsl_set_error_handler_off() first, as mainController and the test mains
+// do.
 class Integrator {
 public:
     Integrator(double (*const integrand)(double, void*), void * const params,
                double _absTolerance, double _relTolerance);
     ~Integrator();
+    // Adaptive Gauss-Kronrod with extrapolation (qags), which copes with
+    // integrable singularities at the ends.  Logs to errorLog if the 
+    // tolerances weren't met.
     double doIntegral(double leftBound, double rightBound, 
                       const Logger& errorLog);
+    IntegralResult integrate(double leftBound, double rightBound);
+    // Fixed Gauss-Kronrod rules of up to 87 points (qng), for smooth 
+    // integrands; integrate takes over if they don't meet the tolerances.
+    IntegralResult integrateSmooth(double leftBound, double rightBound);
+    // Integrate every spec with the same tolerances, split among numThreads
+    // threads; results[i] belongs to specs[i].  smooth picks 
+    // integrateSmooth over integrate.
+    static void integrateBatch(const std::vector<IntegralSpec>& specs,
+                               double absTolerance, double relTolerance,
+                               bool smooth, int numThreads,
+                               std::vector<IntegralResult>& results);
+    // Number of GSL workspaces allocated so far by all threads.
+    static int workspacesAllocated();
 private:
+    // Workspaces come from a free list kept per thread and go back on it
+    // when the Integrator is destroyed, so Integrators made in a loop only
+    // allocate the first time.
+    static gsl_integration_workspace *acquireWorkspace();
+    static void releaseWorkspace(gsl_integration_workspace *workspace);
     gsl_function myFunction;
     gsl_integration_workspace *myWorkspace;
     double absTolerance, relTolerance;
@@ -0,0 +1,135 @@
+/*
+  Copyright (c) 2011 Timothy Lovorn
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <utility>
+
+#include "KGrid.hh"
+
+KPoint::KPoint(double _kx, double _ky) : kx(_kx), ky(_ky) {
+    sinX = sin(kx);
+    sinY = sin(ky);
+    epsA = (sinX + sinY) * (sinX + sinY) - 1.0;
+    epsB = sinX * sinY;
+    weight = 1.0;
+}
+
+KPoint::KPoint(const KGrid& grid, int k) :
+    kx(grid.kx[k]), ky(grid.ky[k]), sinX(grid.sinX[k]), sinY(grid.sinY[k]),
+    epsA(grid.epsA[k]), epsB(grid.epsB[k]), weight(grid.weight[k])
+{ }
+
+KGrid::KGrid(int _gridLen, int _symmetry) : 
+    gridLen(_gridLen), symmetry(_symmetry), numPoints(0), numRows(0)
+{
+    const int N = gridLen;
+    if (symmetry == KGRID_SYM_NONE) {
+        for (int iy = 0; iy < N; iy++) {
+            rowStart.push_back(iy * N);
+            for (int ix = 0; ix < N; ix++) {
+                addPoint(ix, iy, 1.0);
+            }
+        }
+        rowStart.push_back(numPoints);
+        numRows = N;
+        return;
+    }
+    // Walk the orbit of each point not seen yet; that point has the lowest
+    // index in its orbit since all lower ones have been seen.
+    std::vector<bool> seen(N * N, false);
+    std::vector<int> orbit;
+    int lastRow = -1;
+    for (int k = 0; k < N * N; k++) {
+        if (seen[k]) {
+            continue;
+        }
+        seen[k] = true;
+        orbit.assign(1, k);
+        for (size_t i = 0; i < orbit.size(); i++) {
+            const int ix = orbit[i] % N, iy = orbit[i] / N;
+            std::vector<std::pair<int, int> > images;
+            if (symmetry & KGRID_SYM_INVERSION) {
+                images.push_back(std::make_pair((N - ix) % N, (N - iy) % N));
+            }
+            if (symmetry & KGRID_SYM_EXCHANGE) {
+                images.push_back(std::make_pair(iy, ix));
+            }
+            // pi - kx is only on the grid if gridLen is even
+            if ((symmetry & KGRID_SYM_SIN) && N % 2 == 0) {
+                images.push_back(std::make_pair((N / 2 - ix + N) % N, iy));
+                images.push_back(std::make_pair(ix, (N / 2 - iy + N) % N));
+            }
+            for (size_t j = 0; j < images.size(); j++) {
+                const int image = images[j].second * N + images[j].first;
+                if (!seen[image]) {
+                    seen[image] = true;
+                    orbit.push_back(image);
+                }
+            }
+        }
+        if (k / N != lastRow) {
+            lastRow = k / N;
+            rowStart.push_back(numPoints);
+        }
+        addPoint(k % N, k / N, orbit.size());
+    }
+    numRows = rowStart.size();
+    rowStart.push_back(numPoints);
+}
+
+void KGrid::addPoint(int ix, int iy, double pointWeight) {
+    const double step = 2 * M_PI / gridLen;
+    const KPoint point(-M_PI + ix * step, -M_PI + iy * step);
+    kx.push_back(point.kx);
+    ky.push_back(point.ky);
+    sinX.push_back(point.sinX);
+    sinY.push_back(point.sinY);
+    epsA.push_back(point.epsA);
+    epsB.push_back(point.epsB);
+    weight.push_back(pointWeight);
+    cosX.push_back(cos(point.kx));
+    cosY.push_back(cos(point.ky));
+    sinXf.push_back(point.sinX);
+    sinYf.push_back(point.sinY);
+    epsAf.push_back(point.epsA);
+    epsBf.push_back(point.epsB);
+    weightf.push_back(pointWeight);
+    numPoints++;
+}
+
+const KGrid& KGrid::forGridLen(int gridLen, int symmetry) {
+    static std::map<std::pair<int, int>, KGrid*> grids;
+    const std::pair<int, int> key(gridLen, symmetry);
+    KGrid *grid;
+    // BZone traversals may ask for a grid from inside a parallel region.
+    #pragma omp critical(KGrid_forGridLen)
+    {
+        std::map<std::pair<int, int>, KGrid*>::iterator it = grids.find(key);
+        if (it == grids.end()) {
+            grid = new KGrid(gridLen, symmetry);
+            grids[key] = grid;
+        }
+        else {
+            grid = it->second;
+        }
+    }
+    return (const KGrid&)(*grid);
+}
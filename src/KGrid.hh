@@ -0,0 +1,86 @@
+/*
+  Copyright (c) 2011 Timothy Lovorn
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#ifndef __SCSS_K_GRID_H
+#define __SCSS_K_GRID_H
+
+#include <cmath>
+#include <map>
+#include <vector>
+
+class KGrid;
+
+// Symmetries a reduced grid can use, ORed together.  Only declare the ones
+// the summed function really has.
+#define KGRID_SYM_NONE 0
+#define KGRID_SYM_INVERSION 1   // (kx, ky) -> (-kx, -ky)
+#define KGRID_SYM_EXCHANGE 2    // (kx, ky) -> (ky, kx)
+#define KGRID_SYM_SIN 4         // kx -> pi - kx, ky -> pi - ky (separately);
+                                // leaves sin kx and sin ky alone
+#define KGRID_SYM_ALL 7
+
+// Everything about a k-point which doesn't depend on the State.  The
+// spectra only ever need sin(kx), sin(ky) and the two combinations of them
+// making up epsilonBar, so epsilonBar = 2 th epsA + 4 (d1 t0 - thp) epsB.
+struct KPoint {
+    // Compute from scratch (for points not on a grid).
+    KPoint(double _kx, double _ky);
+    // Look up point k of grid.
+    KPoint(const KGrid& grid, int k);
+    double kx, ky, sinX, sinY, 
+           epsA,    // (sinX + sinY)^2 - 1
+           epsB,    // sinX * sinY
+           weight;  // number of full grid points this one stands for
+};
+
+class KGrid {
+public:
+    // Return the grid with the given side length, building it the first 
+    // time it's asked for.  Grids are shared by everything in the process
+    // and never change once built.  With symmetry other than 
+    // KGRID_SYM_NONE, only one point of each orbit under those symmetries
+    // is kept, weighted by the orbit's size.
+    static const KGrid& forGridLen(int gridLen, 
+                                   int symmetry = KGRID_SYM_NONE);
+    // Number of points on a side of the full grid, and symmetries used.
+    const int gridLen, symmetry;
+    // Number of points kept, and of rows they're split into.
+    int numPoints, numRows;
+    // Per-point data.  On the full grid, point k = iy * gridLen + ix is at 
+    // (kx, ky) = (-pi + ix * step, -pi + iy * step).  A reduced grid keeps 
+    // the lowest full grid index from each orbit, in the same order.
+    std::vector<double> kx, ky, sinX, sinY, epsA, epsB, weight;
+    // cos(kx) and cos(ky), for shifting points by angle addition.
+    std::vector<double> cosX, cosY;
+    // Single-precision copies for the float batch kernels.
+    std::vector<float> sinXf, sinYf, epsAf, epsBf, weightf;
+    // Row r is points [rowStart[r], rowStart[r + 1]).  Rows follow the full
+    // grid's rows, leaving out empty ones.
+    std::vector<int> rowStart;
+private:
+    // Only forGridLen builds grids.
+    KGrid(int _gridLen, int _symmetry);
+    // Add full grid point (ix, iy) with the given weight.
+    void addPoint(int ix, int iy, double pointWeight);
+};
+
+#endif
@@ -0,0 +1,78 @@
+/*
+  Copyright (c) 2011 Timothy Lovorn
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include "MultiRootFinder.hh"
+
+MultiRootData::MultiRootData(bool cvg, const std::vector<double>& rt, 
+                             const std::vector<double>& fnv, int iters) :
+    converged(cvg), root(rt), fnvalue(fnv), iterations(iters)
+{ }
+
+MultiRootFinder::MultiRootFinder(
+    int (* const helper)(const gsl_vector*, void*, gsl_vector*),
+    void * const params, const std::vector<double>& guess, 
+    const double tolerance) :
+    myHelper(helper), myParams(params), myGuess(guess), myTolerance(tolerance)
+{ }
+
+// Follows the GSL documentation example
+// http://www.gnu.org/software/gsl/manual/html_node/Example-programs-for-Multidimensional-Root-finding.html
+
+MultiRootData MultiRootFinder::findRoot() {
+    const size_t n = myGuess.size();
+    int status;
+    int iter = 0;
+
+    gsl_multiroot_function F;
+    F.f = myHelper;
+    F.n = n;
+    F.params = myParams;
+
+    gsl_vector *x = gsl_vector_alloc(n);
+    for (size_t i = 0; i < n; i++) {
+        gsl_vector_set(x, i, myGuess[i]);
+    }
+    gsl_multiroot_fsolver *s = 
+        gsl_multiroot_fsolver_alloc(gsl_multiroot_fsolver_hybrids, n);
+    status = gsl_multiroot_fsolver_set(s, &F, x);
+    if (status == GSL_SUCCESS) {
+        do {
+            iter++;
+            status = gsl_multiroot_fsolver_iterate(s);
+            if (status != GSL_SUCCESS) {
+                break;  // stuck, or helper couldn't evaluate a step
+            }
+            status = gsl_multiroot_test_residual(
+                gsl_multiroot_fsolver_f(s), myTolerance);
+        } while (status == GSL_CONTINUE && iter < MRF_MAX_ITER);
+    }
+
+    std::vector<double> root(n), fnvalue(n);
+    for (size_t i = 0; i < n; i++) {
+        root[i] = gsl_vector_get(gsl_multiroot_fsolver_root(s), i);
+        fnvalue[i] = gsl_vector_get(gsl_multiroot_fsolver_f(s), i);
+    }
+    gsl_multiroot_fsolver_free(s);
+    gsl_vector_free(x);
+
+    return MultiRootData(status == GSL_SUCCESS, root, fnvalue, iter);
+}
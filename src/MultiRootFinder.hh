@@ -0,0 +1,73 @@
+/*
+  Copyright (c) 2011 Timothy Lovorn
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#ifndef __SCSS_MULTI_ROOT_FINDER_H
+#define __SCSS_MULTI_ROOT_FINDER_H
+
+#include <vector>
+
+#include <gsl/gsl_errno.h>
+#include <gsl/gsl_vector.h>
+#include <gsl/gsl_multiroots.h>
+
+// -- multi-dimensional --
+
+#define MRF_MAX_ITER 256
+
+class MultiRootData {
+public:
+    MultiRootData(bool cvg, const std::vector<double>& rt, 
+                  const std::vector<double>& fnv, int iters);
+    bool converged;
+    std::vector<double> root, fnvalue;
+    int iterations;
+};
+
+class MultiRootFinder {
+public:
+    // Constructor.  Only saves parameters.  helper(x, params, f) sets f to
+    // the function's value at x and returns GSL_SUCCESS, or returns an
+    // error code if the function can't be evaluated at x.
+    MultiRootFinder(int (* const helper)(const gsl_vector*, void*, gsl_vector*),
+                    void * const params, const std::vector<double>& guess,
+                    const double tolerance);
+    // Solve with the Powell hybrid method (Newton steps using a 
+    // finite-difference Jacobian which is kept up to date with Broyden
+    // updates).  Converged if the sum of abs(f_i) at the root is below
+    // myTolerance.  GSL errors are reported through the return value, so
+    // callers can fall back to something else, only if GSL's error handler
+    // is off: every program using this, directly or through a coupled 
+    // solve, must call gsl_set_error_handler_off() first, as mainController
+    // and the test mains do.
+    MultiRootData findRoot();
+private:
+    // Function to find root of.
+    int (* const myHelper)(const gsl_vector*, void*, gsl_vector*);
+    // Extra parameters to pass in to function
+    void * const myParams;
+    // Starting values for the variables.
+    const std::vector<double> myGuess;
+    // If findRoot converges, then sum(abs(f_i)) < myTolerance.
+    const double myTolerance;
+};
+
+#endif
@@ -20,43 +20,115 @@
   THE SOFTWARE.
 */
 
+#include <algorithm>
+
 #include "PairTempSpectrum.hh"
 
-double PairTempSpectrum::epsilon(const PairTempState& st, double kx, 
-                                 double ky) {
-    return epsilonBar(st, kx, ky) - st.getEpsilonMin();
+double PairTempSpectrum::epsilon(const PairTempState& st, const KPoint& k) {
+    return epsilonBar(st, k) - st.getEpsilonMin();
 }
 
-double PairTempSpectrum::epsilonBar(const PairTempState& st, double kx, 
-                                    double ky) {
+double PairTempSpectrum::epsilonBar(const PairTempState& st, 
+                                    const KPoint& k) {
     const PairTempEnvironment& env = st.env;
-    const double sx = sin(kx);
-    const double sy = sin(ky);
-    return 2.0 * env.th * ((sx + sy) * (sx + sy) - 1.0)
-         + 4.0 * (st.getD1() * env.t0 - env.thp) * sx * sy;
+    return 2.0 * env.th * k.epsA
+         + 4.0 * (st.getD1() * env.t0 - env.thp) * k.epsB;
 }
 
-double PairTempSpectrum::xi(const PairTempState& st, double kx, double ky) {
-    return epsilon(st, kx, ky) - st.getMu();
+double PairTempSpectrum::xi(const PairTempState& st, const KPoint& k) {
+    return epsilon(st, k) - st.getMu();
 }
 
 double PairTempSpectrum::fermi(const PairTempState& st, double energy) {
     return 1.0 / (exp(st.getBp() * energy) + 1.0);
 }
 
-double PairTempSpectrum::innerD1(const PairTempState& st, double kx, 
-                                 double ky) {
-    return -sin(kx) * sin(ky) * fermi(st, xi(st, kx, ky));
+double PairTempSpectrum::innerD1(const PairTempState& st, const KPoint& k) {
+    return -k.epsB * fermi(st, xi(st, k));
+}
+
+double PairTempSpectrum::innerMu(const PairTempState& st, const KPoint& k) {
+    return fermi(st, xi(st, k));
+}
+
+double PairTempSpectrum::innerBp(const PairTempState& st, const KPoint& k) {
+    const double sin_part = k.sinX - k.sinY;
+    const double xi_k = xi(st, k);
+    return sin_part * sin_part * tanh(st.getBp() * xi_k / 2.0) / xi_k;
 }
 
-double PairTempSpectrum::innerMu(const PairTempState& st, double kx, 
-                                 double ky) {
-    return fermi(st, xi(st, kx, ky));
+void PairTempSpectrum::innerAll(const PairTempState& st, const KPoint& k,
+                                double *terms) {
+    const double xi_k = xi(st, k);
+    const double occupation = fermi(st, xi_k);
+    const double sin_part = k.sinX - k.sinY;
+    terms[0] = -k.epsB * occupation;
+    terms[1] = occupation;
+    terms[2] = sin_part * sin_part * tanh(st.getBp() * xi_k / 2.0) / xi_k;
 }
 
-double PairTempSpectrum::innerBp(const PairTempState& st, double kx, 
-                                 double ky) {
-    const double sin_part = sin(kx) - sin(ky);
-    return sin_part * sin_part * tanh(st.getBp() * xi(st, kx, ky) / 2.0) / 
-           xi(st, kx, ky);
+// tanh(beta xi / 2) = 1 - 2 fermi(xi), so each point needs only one exp.
+SCSS_TARGET_CLONES
+void PairTempSpectrum::innerAllBatch(const PairTempState& st, 
+                                     const KGrid& grid, int begin, int end, 
+                                     double *sums) {
+    const PairTempEnvironment& env = st.env;
+    const double coeffA = 2.0 * env.th, 
+                 coeffB = 4.0 * (st.getD1() * env.t0 - env.thp),
+                 epsilonMin = st.getEpsilonMin(), mu = st.getMu(),
+                 beta = st.getBp();
+    const double *sinX = &grid.sinX[0], *sinY = &grid.sinY[0],
+                 *epsA = &grid.epsA[0], *epsB = &grid.epsB[0],
+                 *weight = &grid.weight[0];
+    double sumD1 = 0.0, sumOcc = 0.0, sumTanh = 0.0;
+    #pragma omp simd reduction(+:sumD1,sumOcc,sumTanh)
+    for (int k = begin; k < end; k++) {
+        const double xi_k = coeffA * epsA[k] + coeffB * epsB[k] 
+                            - epsilonMin - mu;
+        const double occupation = 1.0 / (exp(beta * xi_k) + 1.0);
+        const double sin_part = sinX[k] - sinY[k];
+        sumD1 += weight[k] * (-epsB[k] * occupation);
+        sumOcc += weight[k] * occupation;
+        sumTanh += weight[k] 
+                   * (sin_part * sin_part * (1.0 - 2.0 * occupation) / xi_k);
+    }
+    sums[0] = sumD1;
+    sums[1] = sumOcc;
+    sums[2] = sumTanh;
+}
+
+// Mirrors innerAllBatch; the shift epsilonMin + mu is taken in double first.
+SCSS_TARGET_CLONES
+void PairTempSpectrum::innerAllBatchFloat(const PairTempState& st, 
+                                          const KGrid& grid, int begin, 
+                                          int end, double *sums) {
+    const PairTempEnvironment& env = st.env;
+    const float coeffA = 2.0 * env.th, 
+                coeffB = 4.0 * (st.getD1() * env.t0 - env.thp),
+                shift = st.getEpsilonMin() + st.getMu(),
+                beta = st.getBp();
+    const float *sinX = &grid.sinXf[0], *sinY = &grid.sinYf[0],
+                *epsA = &grid.epsAf[0], *epsB = &grid.epsBf[0],
+                *weight = &grid.weightf[0];
+    KahanFloat sumD1, sumOcc, sumTanh;
+    for (int block = begin; block < end; block += SCSS_FLOAT_BLOCK) {
+        const int blockEnd = std::min(block + SCSS_FLOAT_BLOCK, end);
+        float blockD1 = 0.0f, blockOcc = 0.0f, blockTanh = 0.0f;
+        #pragma omp simd reduction(+:blockD1,blockOcc,blockTanh)
+        for (int k = block; k < blockEnd; k++) {
+            const float xi_k = coeffA * epsA[k] + coeffB * epsB[k] - shift;
+            const float occupation = 1.0f / (expf(beta * xi_k) + 1.0f);
+            const float sin_part = sinX[k] - sinY[k];
+            blockD1 += weight[k] * (-epsB[k] * occupation);
+            blockOcc += weight[k] * occupation;
+            blockTanh += weight[k] * (sin_part * sin_part 
+                                      * (1.0f - 2.0f * occupation) / xi_k);
+        }
+        sumD1.add(blockD1);
+        sumOcc.add(blockOcc);
+        sumTanh.add(blockTanh);
+    }
+    sums[0] = sumD1.sum;
+    sums[1] = sumOcc.sum;
+    sums[2] = sumTanh.sum;
 }
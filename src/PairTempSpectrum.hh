@@ -26,21 +26,36 @@
 #include <cmath>
 
 #include "PairTempState.hh"
+#include "KGrid.hh"
+#include "Vectorize.hh"
 
 class PairTempSpectrum {
 public:
     // One-hole spectrum to be used, minimum at 0
-    static double epsilon(const PairTempState& st, double kx, double ky);
+    static double epsilon(const PairTempState& st, const KPoint& k);
     // One-hole spectrum unmodified from theory
-    static double epsilonBar(const PairTempState& st, double kx, double ky);
+    static double epsilonBar(const PairTempState& st, const KPoint& k);
     // One-hole energy, epsilon - mu
-    static double xi(const PairTempState& st, double kx, double ky);
+    static double xi(const PairTempState& st, const KPoint& k);
     // Fermi distribution function (for T>0)
     static double fermi(const PairTempState& st, double energy);
     // term to be summed to calculate rhs of associated S-C equation
-    static double innerD1(const PairTempState& st, double kx, double ky);
-    static double innerMu(const PairTempState& st, double kx, double ky);
-    static double innerBp(const PairTempState& st, double kx, double ky);
+    static double innerD1(const PairTempState& st, const KPoint& k);
+    static double innerMu(const PairTempState& st, const KPoint& k);
+    static double innerBp(const PairTempState& st, const KPoint& k);
+    // all three terms at once, sharing xi:
+    // terms = {innerD1, innerMu, innerBp}
+    static void innerAll(const PairTempState& st, const KPoint& k, 
+                         double *terms);
+    // Weighted sums of innerAll's terms over grid points [begin, end), 
+    // computed straight from the grid arrays so the loop vectorizes.
+    static void innerAllBatch(const PairTempState& st, const KGrid& grid, 
+                              int begin, int end, double *sums);
+    // Same sums in single precision (see SCSS_FLOAT_BLOCK), for early
+    // iterations where twice the SIMD width matters more than accuracy.
+    static void innerAllBatchFloat(const PairTempState& st, 
+                                   const KGrid& grid, int begin, int end, 
+                                   double *sums);
 };
 
 #endif
@@ -20,6 +20,8 @@
   THE SOFTWARE.
 */
 
+#include <algorithm>
+
 #include "PairTempState.hh"
 
 PairTempState::PairTempState(const PairTempEnvironment& envIn) : 
@@ -29,21 +31,79 @@ PairTempState::PairTempState(const PairTempEnvironment& envIn) :
 }
 
 // driver
-bool PairTempState::makeSelfConsistent() {
-    do {
+bool PairTempState::solve() {
+    if (env.solverMode == "coupled") {
+        if (fixCoupled() && checkSelfConsistent()) {
+            return true;
+        }
+        env.errorLog.printf("Coupled solve failed, using nested solve.\n");
+    }
+    std::vector<double> weights(3);
+    weights[0] = 1.0 / env.tolD1;
+    weights[1] = 1.0 / env.tolMu;
+    weights[2] = 1.0 / env.tolBp;
+    AndersonMixer mixer(3, env.andersonDepth, weights);
+    outerIterations = 0;
+    startPrecision();
+    bool converged = false;
+    while (!converged && outerIterations < outerMaxIters) {
+        std::vector<double> start(3);
+        start[0] = d1;
+        start[1] = mu;
+        start[2] = bp;
         fixD1();
         env.debugLog.printf("got d1 = %e\n", d1);
         fixMu();
         env.debugLog.printf("got mu = %e\n", mu);
         fixBp();
         env.debugLog.printf("got bp = %e\n", bp);
-    } while (!checkSelfConsistent());
-    return checkSelfConsistent();
+        outerIterations++;
+        // Check before mixing: the mixed values don't each solve their own
+        // equation the way the plain step's values do.
+        // Errors from the single-precision kernels can't show convergence.
+        converged = !lowPrecision && checkSelfConsistent();
+        if (lowPrecision) {
+            updatePrecision(maxScaledError(), &PairTempState::gridTerms, 3);
+        }
+        if (!converged && env.mixingMode == "anderson") {
+            std::vector<double> step(3);
+            step[0] = d1;
+            step[1] = mu;
+            step[2] = bp;
+            const std::vector<double> next = mixer.mix(start, step);
+            if (next[2] > 0.0) {
+                d1 = next[0];
+                mu = next[1];
+                bp = next[2];
+                setEpsilonMin();
+                env.debugLog.printf("mixed to d1 = %e, mu = %e, bp = %e\n",
+                                    d1, mu, bp);
+            } else {
+                // Mixed values are out of range; keep the plain step.
+                mixer.reset();
+            }
+        }
+    }
+    lowPrecision = false;
+    if (!converged) {
+        env.errorLog.printf("Outer loop failed to converge!\n");
+    }
+    const int plainIterations = mixer.estimatePlainSteps();
+    outerIterationsSaved = plainIterations > outerIterations ? 
+                           plainIterations - outerIterations : 0;
+    env.debugLog.printf("outer iterations = %d, saved by mixing = %d\n", 
+                        outerIterations, outerIterationsSaved);
+    return converged;
 }
 
 // checkers
 bool PairTempState::checkSelfConsistent() const {
-    return checkD1() && checkMu() && checkBp();
+    return checkSelfConsistent(absErrors());
+}
+
+bool PairTempState::checkSelfConsistent(const PairTempErrors& errors) const {
+    return fabs(errors.d1) < env.tolD1 && fabs(errors.mu) < env.tolMu
+        && fabs(errors.bp) < env.tolBp;
 }
 
 bool PairTempState::checkBp() const {
@@ -53,44 +113,123 @@ bool PairTempState::checkBp() const {
 // error calculators
 double PairTempState::absErrorD1() const {
     double lhs = d1;
-    double rhs = BZone::average<PairTempState>(*this, *this, 
-                                               PairTempSpectrum::innerD1);
+    double rhs;
+    if (separateSums()) {
+        rhs = BZone::average<PairTempState>(*this, *this, 
+                                            PairTempSpectrum::innerD1,
+                                            termSymmetry());
+    } else {
+        double terms[3];
+        averageTerms(terms);
+        rhs = terms[0];
+    }
     return lhs - rhs;
 }
 
 double PairTempState::absErrorMu() const {
     double lhs = env.x;
-    double rhs = BZone::average<PairTempState>(*this, *this,
-                                               PairTempSpectrum::innerMu);
+    double rhs;
+    if (separateSums()) {
+        rhs = BZone::average<PairTempState>(*this, *this, 
+                                            PairTempSpectrum::innerMu,
+                                            termSymmetry());
+    } else {
+        double terms[3];
+        averageTerms(terms);
+        rhs = terms[1];
+    }
     return lhs - rhs;
 }
 
 double PairTempState::absErrorBp() const {
     double lhs = 1.0 / (env.t0 + env.tz);
-    double rhs = BZone::average<PairTempState>(*this, *this,
-                                               PairTempSpectrum::innerBp);
+    double rhs;
+    if (separateSums()) {
+        rhs = BZone::average<PairTempState>(*this, *this, 
+                                            PairTempSpectrum::innerBp,
+                                            termSymmetry());
+    } else {
+        double terms[3];
+        averageTerms(terms);
+        rhs = terms[2];
+    }
     return lhs - rhs;
 }
 
+void PairTempState::averageTerms(double *rhs, double *discError) const {
+    if (env.bzoneIntegrator == "adaptive") {
+        noteAdaptive(AdaptiveBZone::averages<PairTempState>(*this, *this, 
+            PairTempSpectrum::innerAll, 3, rhs, discError, termSymmetry()));
+        return;
+    }
+    extrapolateTerms(&PairTempState::gridTerms, 3, rhs, discError);
+}
+
+void PairTempState::gridTerms(const BaseState& stBase, double *rhs) {
+    const PairTempState& st = (const PairTempState&)stBase;
+    if (st.env.kernelMode == "scalar") {
+        BZone::averages<PairTempState>(st, st, PairTempSpectrum::innerAll, 3, 
+                                       rhs, st.termSymmetry());
+    } else if (st.lowPrecision) {
+        BZone::averagesBatch<PairTempState>(st, st, 
+            PairTempSpectrum::innerAllBatchFloat, 3, rhs, st.termSymmetry());
+    } else {
+        BZone::averagesBatch<PairTempState>(st, st, 
+            PairTempSpectrum::innerAllBatch, 3, rhs, st.termSymmetry());
+    }
+}
+
+PairTempErrors PairTempState::absErrors(double *discError) const {
+    double rhs[3];
+    averageTerms(rhs, discError);
+    return errorsFromTerms(rhs);
+}
+
+PairTempErrors PairTempState::errorsFromTerms(const double *rhs) const {
+    PairTempErrors errors;
+    errors.d1 = d1 - rhs[0];
+    errors.mu = env.x - rhs[1];
+    errors.bp = 1.0 / (env.t0 + env.tz) - rhs[2];
+    return errors;
+}
+
+double PairTempState::maxScaledError() const {
+    const PairTempErrors errors = absErrors();
+    return std::max(std::max(fabs(errors.d1) / env.tolD1, 
+                             fabs(errors.mu) / env.tolMu),
+                    fabs(errors.bp) / env.tolBp);
+}
+
 double PairTempState::relErrorD1() const {
-    double error = absErrorD1();
+    return relErrorD1(absErrorD1());
+}
+
+double PairTempState::relErrorD1(double error) const {
     if (d1 == 0.0 && error == 0.0) {
         return 0.0;
     }
     else if (d1 == 0.0) {
-        return fabs(d1) / fabs(absErrorD1());
+        return fabs(d1) / fabs(error);
     }
     else {
-        return fabs(absErrorD1()) / fabs(d1);
+        return fabs(error) / fabs(d1);
     }
 }
 
 double PairTempState::relErrorMu() const {
-    return fabs(absErrorMu()) / env.x;
+    return relErrorMu(absErrorMu());
+}
+
+double PairTempState::relErrorMu(double error) const {
+    return fabs(error) / env.x;
 }
 
 double PairTempState::relErrorBp() const {
-    return fabs(absErrorBp()) * (env.t0 + env.tz);
+    return relErrorBp(absErrorBp());
+}
+
+double PairTempState::relErrorBp(double error) const {
+    return fabs(error) * (env.t0 + env.tz);
 }
 
 // getters
@@ -100,20 +239,84 @@ double PairTempState::getBp() const {
 
 // logging
 void PairTempState::logState() const {
-    std::string sc = checkSelfConsistent() ? "true" : "false";
+    double discError[3];
+    const PairTempErrors errors = absErrors(discError);
+    std::string sc = checkSelfConsistent(errors) ? "true" : "false";
     env.outputLog.printf("<begin>,state\n");
     env.outputLog.printf("self-consistent,%s\n", sc.c_str());
-    env.outputLog.printf("d1,%e\nd1RelError,%e\n", getD1(), relErrorD1());
-    env.outputLog.printf("mu,%e\nmuRelError,%e\n", getMu(), relErrorMu());
-    env.outputLog.printf("bp,%e\nbpRelError,%e\n", getBp(), relErrorBp());
+    env.outputLog.printf("d1,%e\nd1RelError,%e\n", getD1(), 
+                         relErrorD1(errors.d1));
+    env.outputLog.printf("mu,%e\nmuRelError,%e\n", getMu(), 
+                         relErrorMu(errors.mu));
+    env.outputLog.printf("bp,%e\nbpRelError,%e\n", getBp(), 
+                         relErrorBp(errors.bp));
+    if (env.extrapolationLevels > 1) {
+        env.outputLog.printf("d1DiscError,%e\nmuDiscError,%e\n"
+                             "bpDiscError,%e\n", discError[0], 
+                             discError[1], discError[2]);
+    }
+    if (env.bzoneIntegrator == "adaptive") {
+        logAdaptive();
+    }
+    if (env.precisionMode == "mixed") {
+        env.outputLog.printf("precisionSwitchIteration,%d\n"
+                             "floatSumError,%e\n", precisionSwitchIteration,
+                             floatSumError);
+    }
+    env.outputLog.printf("outerIterations,%d\nouterIterationsSaved,%d\n",
+                         outerIterations, outerIterationsSaved);
     env.outputLog.printf("<end>,state\n");
 }
 
+// lockstep solving
+int PairTempState::numVariables() const {
+    return 3;
+}
+
+void PairTempState::getVariables(double *vars) const {
+    vars[0] = d1;
+    vars[1] = mu;
+    vars[2] = bp;
+}
+
+void PairTempState::setVariables(const double *vars) {
+    d1 = vars[0];
+    mu = vars[1];
+    bp = vars[2];
+    setEpsilonMin();    // D1 changed so epsilonMin might change
+}
+
+bool PairTempState::batchScaledErrors(
+        const std::vector<const BaseState*>& states, double *errors) const {
+    std::vector<const PairTempState*> pairStates;
+    for (size_t s = 0; s < states.size(); s++) {
+        const PairTempState *st = 
+            dynamic_cast<const PairTempState*>(states[s]);
+        if (st == NULL || !st->plainBatchSums() 
+            || st->getGridLen() != getGridLen()
+            || st->termSymmetry() != termSymmetry()) {
+            return false;
+        }
+        pairStates.push_back(st);
+    }
+    std::vector<double> rhs(3 * states.size());
+    BZone::averagesBatchMulti<PairTempState>(pairStates, 
+        PairTempSpectrum::innerAllBatch, 3, &rhs[0], termSymmetry());
+    for (size_t s = 0; s < states.size(); s++) {
+        const PairTempState& st = *pairStates[s];
+        const PairTempErrors stErrors = st.errorsFromTerms(&rhs[3 * s]);
+        errors[3 * s] = stErrors.d1 / st.env.tolD1;
+        errors[3 * s + 1] = stErrors.mu / st.env.tolMu;
+        errors[3 * s + 2] = stErrors.bp / st.env.tolBp;
+    }
+    return true;
+}
+
 // variable manipulators
-double PairTempState::setEpsilonMin() {
-    epsilonMin = BZone::minimum<PairTempState>(*this, *this, 
-                                               PairTempSpectrum::epsilonBar);
-    return epsilonMin;
+double PairTempState::gridEpsilonMin() const {
+    return BZone::minimum<PairTempState>(*this, *this, 
+                                     PairTempSpectrum::epsilonBar,
+                                     termSymmetry());
 }
 
 double PairTempState::helperD1(double x, void *params) {
@@ -145,6 +348,8 @@ bool PairTempState::fixD1() {
     double old_d1 = d1;
     RootFinder rootFinder(&PairTempState::helperD1, this, d1, 
                           0.0, 1.0, env.tolD1 / 10);
+    CoarseBracket coarse(this, &PairTempState::helperD1, this);
+    setCoarseBracket(rootFinder, coarse);
     const RootData& rootData = rootFinder.findRoot();
     if (!rootData.converged) {
         env.errorLog.printf("D1 failed to converge!\n");
@@ -158,6 +363,8 @@ bool PairTempState::fixMu() {
     double old_mu = mu;
     RootFinder rootFinder(&PairTempState::helperMu, this, mu, 
                           -1.0, 0.0, env.tolMu / 10);
+    CoarseBracket coarse(this, &PairTempState::helperMu, this);
+    setCoarseBracket(rootFinder, coarse);
     const RootData& rootData = rootFinder.findRoot();
     if (!rootData.converged) {
         env.errorLog.printf("Mu failed to converge!\n");
@@ -171,6 +378,8 @@ bool PairTempState::fixBp() {
     double old_bp = bp;
     RootFinder rootFinder(&PairTempState::helperBp, this, bp,
                           0.0, 1e6, env.tolBp / 10);
+    CoarseBracket coarse(this, &PairTempState::helperBp, this);
+    setCoarseBracket(rootFinder, coarse);
     const RootData& rootData = rootFinder.findRoot();
     if (!rootData.converged) {
         env.errorLog.printf("F0 failed to converge!\n");
@@ -179,3 +388,55 @@ bool PairTempState::fixBp() {
     }
     return true;
 }
+
+// Residuals are scaled by their tolerances so that every variable counts the
+// same in the solver's convergence test.
+int PairTempState::helperCoupled(const gsl_vector *x, void *params, 
+                                 gsl_vector *f) {
+    PairTempState *st = (PairTempState*)params;
+    st->d1 = gsl_vector_get(x, 0);
+    st->mu = gsl_vector_get(x, 1);
+    st->bp = gsl_vector_get(x, 2);
+    if (st->bp <= 0.0) {
+        return GSL_EDOM;
+    }
+    st->setEpsilonMin();    // D1 changed so epsilonMin might change
+    const PairTempErrors errors = st->absErrors();
+    gsl_vector_set(f, 0, errors.d1 / st->env.tolD1);
+    gsl_vector_set(f, 1, errors.mu / st->env.tolMu);
+    gsl_vector_set(f, 2, errors.bp / st->env.tolBp);
+    st->env.debugLog.printf("coupled trial d1 = %e, mu = %e, bp = %e\n", 
+                            st->d1, st->mu, st->bp);
+    if (!(gsl_finite(gsl_vector_get(f, 0)) && gsl_finite(gsl_vector_get(f, 1))
+          && gsl_finite(gsl_vector_get(f, 2)))) {
+        return GSL_EBADFUNC;
+    }
+    return GSL_SUCCESS;
+}
+
+bool PairTempState::fixCoupled() {
+    double old_d1 = d1, old_mu = mu, old_bp = bp;
+    std::vector<double> guess(3);
+    guess[0] = d1;
+    guess[1] = mu;
+    guess[2] = bp;
+    MultiRootFinder rootFinder(&PairTempState::helperCoupled, this, guess, 0.1);
+    const MultiRootData& rootData = rootFinder.findRoot();
+    if (!rootData.converged) {
+        env.errorLog.printf("Coupled solve failed to converge after %d "
+                            "iterations!\n", rootData.iterations);
+        d1 = old_d1;
+        mu = old_mu;
+        bp = old_bp;
+        setEpsilonMin();
+        return false;
+    }
+    d1 = rootData.root[0];
+    mu = rootData.root[1];
+    bp = rootData.root[2];
+    setEpsilonMin();
+    env.debugLog.printf("coupled solve got d1 = %e, mu = %e, bp = %e "
+                        "in %d iterations\n", d1, mu, bp, 
+                        rootData.iterations);
+    return true;
+}
@@ -36,12 +36,23 @@ RootFinder::RootFinder(double (* const helper)(double, void *),
     void * const params, const double guess, const double min, 
     const double max, const double tolerance) :
     myHelper(helper), myParams(params), myGuess(guess), myMin(min), myMax(max), 
-    myTolerance(tolerance) 
+    myTolerance(tolerance), myBracketHelper(helper), myBracketParams(params)
 { }
 
+void RootFinder::setBracketHelper(double (*helper)(double, void*), 
+                                  void *params) {
+    myBracketHelper = helper;
+    myBracketParams = params;
+}
+
+const BracketData& RootFinder::bracket() {
+    return bracket(myBracketHelper, myBracketParams);
+}
+
 // this is so broken
 // need to make sure it doesn't overshoot bounds
-const BracketData& RootFinder::bracket() {
+const BracketData& RootFinder::bracket(double (*helper)(double, void*),
+                                      void *params) {
     int iteration = 1;
     double step, left, right, fnleft, fnright;
     BracketData *bdata;
@@ -53,8 +64,8 @@ const BracketData& RootFinder::bracket() {
         left = myGuess + (iteration - 1) * step;
         if (right > myMax) right = myMax;
         if (left > myMax) left = myMax - step;
-        fnright = myHelper(right, myParams);
-        fnleft = myHelper(left, myParams);
+        fnright = helper(right, params);
+        fnleft = helper(left, params);
         if ((fnleft >= 0 && fnright <= 0) || (fnright >= 0 && fnleft <= 0)) {
             bdata = new BracketData(true, left, right, fnleft, fnright);
             return (const BracketData&)(*bdata);
@@ -63,8 +74,8 @@ const BracketData& RootFinder::bracket() {
         left = myGuess - iteration * step;
         if (left < myMin) left = myMin;
         if (right < myMin) right = myMin + step;
-        fnright = myHelper(right, myParams);
-        fnleft = myHelper(left, myParams);
+        fnright = helper(right, params);
+        fnleft = helper(left, params);
         if ((fnleft >= 0 && fnright <= 0) || (fnright >= 0 && fnleft <= 0)) {
             bdata = new BracketData(true, left, right, fnleft, fnright);
             return (const BracketData&)(*bdata);
@@ -79,7 +90,21 @@ const BracketData& RootFinder::bracket() {
 // http://www.gnu.org/software/gsl/manual/html_node/Root-Finding-Examples.html
 
 const RootData& RootFinder::findRoot() {
-    const BracketData& bdata = bracket();
+    const BracketData *bracketed = &bracket();
+    if (myBracketHelper != myHelper || myBracketParams != myParams) {
+        // Rescan with the real function unless the cheap bracket holds.
+        bool holds = false;
+        if (bracketed->success) {
+            double fnleft = myHelper(bracketed->left, myParams),
+                   fnright = myHelper(bracketed->right, myParams);
+            holds = (fnleft >= 0 && fnright <= 0) 
+                    || (fnright >= 0 && fnleft <= 0);
+        }
+        if (!holds) {
+            bracketed = &bracket(myHelper, myParams);
+        }
+    }
+    const BracketData& bdata = *bracketed;
     if (bdata.success == false) {
         const RootData *rdata = new RootData(false, myGuess,
                                              myHelper(myGuess, myParams));
@@ -57,7 +57,15 @@ public:
     // If a root is found, returns true.  Otherwise returns false.
     const RootData& findRoot();
     const BracketData& bracket();
+    // Scan for the bracket with a cheaper approximation of the function.
+    // findRoot checks the bracket it finds against the real function and
+    // scans again with that if the signs don't hold up or the cheap scan
+    // finds no bracket at all.
+    void setBracketHelper(double (*helper)(double, void*), void *params);
 private:
+    // Scan for a sign change of helper outward from myGuess.
+    const BracketData& bracket(double (*helper)(double, void*), 
+                               void *params);
     // Function to find root of.
     double (* const myHelper)(double, void *);
     // Extra parameters to pass in to function
@@ -68,6 +76,9 @@ private:
     const double myMin, myMax;
     // If findRoot returns true, then abs(myFn()) <= myTolerance.
     const double myTolerance;
+    // Function (and parameters) used by bracket().
+    double (*myBracketHelper)(double, void *);
+    void *myBracketParams;
 };
 
 #endif
@@ -0,0 +1,251 @@
+/*
+  Copyright (c) 2011 Timothy Lovorn
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <typeinfo>
+
+#include <gsl/gsl_math.h>
+
+#include "SweepSolver.hh"
+
+// Solve the n x n system A x = b in place (b becomes x) by Gaussian 
+// elimination with partial pivoting.  Return false if A is singular.
+static bool solveLinear(int n, std::vector<double>& A, 
+                        std::vector<double>& b) {
+    for (int col = 0; col < n; col++) {
+        int pivot = col;
+        for (int row = col + 1; row < n; row++) {
+            if (fabs(A[row * n + col]) > fabs(A[pivot * n + col])) {
+                pivot = row;
+            }
+        }
+        if (A[pivot * n + col] == 0.0 || !gsl_finite(A[pivot * n + col])) {
+            return false;
+        }
+        if (pivot != col) {
+            for (int k = 0; k < n; k++) {
+                std::swap(A[col * n + k], A[pivot * n + k]);
+            }
+            std::swap(b[col], b[pivot]);
+        }
+        for (int row = col + 1; row < n; row++) {
+            const double factor = A[row * n + col] / A[col * n + col];
+            for (int k = col; k < n; k++) {
+                A[row * n + k] -= factor * A[col * n + k];
+            }
+            b[row] -= factor * b[col];
+        }
+    }
+    for (int row = n - 1; row >= 0; row--) {
+        for (int k = row + 1; k < n; k++) {
+            b[row] -= A[row * n + k] * b[k];
+        }
+        b[row] /= A[row * n + row];
+    }
+    return true;
+}
+
+// Largest magnitude among errors[0, n), or infinity if any isn't finite.
+static double maxError(int n, const double *errors) {
+    double max = 0.0;
+    for (int i = 0; i < n; i++) {
+        if (!gsl_finite(errors[i])) {
+            return HUGE_VAL;
+        }
+        if (fabs(errors[i]) > max) {
+            max = fabs(errors[i]);
+        }
+    }
+    return max;
+}
+
+SweepSolver::SweepSolver(const std::vector<BaseState*>& states) :
+    myStates(states)
+{ }
+
+bool SweepSolver::solve() {
+    std::vector<bool> done(myStates.size(), false);
+    bool allConverged = true;
+    for (size_t first = 0; first < myStates.size(); first++) {
+        if (done[first]) {
+            continue;
+        }
+        // Group everything of the same class on the same grid.
+        std::vector<BaseState*> group;
+        std::vector<size_t> members;
+        for (size_t s = first; s < myStates.size(); s++) {
+            if (!done[s] && typeid(*myStates[s]) == typeid(*myStates[first])
+                && myStates[s]->getGridLen() == myStates[first]->getGridLen()) {
+                group.push_back(myStates[s]);
+                members.push_back(s);
+                done[s] = true;
+            }
+        }
+        std::vector<bool> converged(group.size(), false);
+        const int n = group[0]->numVariables();
+        std::vector<double> start(group.size() * n);
+        for (size_t g = 0; g < group.size(); g++) {
+            group[g]->getVariables(&start[g * n]);
+        }
+        if (!solveGroup(group, converged)) {
+            group[0]->env.debugLog.printf("Can't batch this State; solving"
+                                          " %d States one at a time.\n", 
+                                          (int)group.size());
+        }
+        for (size_t g = 0; g < group.size(); g++) {
+            if (converged[g]) {
+                continue;
+            }
+            group[g]->setVariables(&start[g * n]);
+            group[g]->env.errorLog.printf("Sweep didn't converge State %d; "
+                                          "solving it on its own.\n", 
+                                          (int)members[g]);
+            if (!group[g]->makeSelfConsistent()) {
+                allConverged = false;
+            }
+        }
+    }
+    return allConverged;
+}
+
+bool SweepSolver::evaluate(const std::vector<BaseState*>& group, 
+                           const std::vector<int>& index, double *errors) {
+    std::vector<const BaseState*> states(index.size());
+    for (size_t a = 0; a < index.size(); a++) {
+        states[a] = group[index[a]];
+    }
+    return states[0]->batchScaledErrors(states, errors);
+}
+
+bool SweepSolver::solveGroup(const std::vector<BaseState*>& group,
+                             std::vector<bool>& converged) {
+    const int n = group[0]->numVariables(), numStates = group.size();
+    std::vector<double> vars(numStates * n), errors(numStates * n);
+    std::vector<int> active(numStates);
+    for (int g = 0; g < numStates; g++) {
+        group[g]->getVariables(&vars[g * n]);
+        active[g] = g;
+    }
+    if (!evaluate(group, active, &errors[0])) {
+        return false;
+    }
+    std::vector<double> activeErrors(numStates * n), 
+                        jacobian(numStates * n * n), step(numStates * n);
+    for (int iteration = 0; iteration <= SWEEP_MAX_ITERS; iteration++) {
+        // Drop converged States; errors stays indexed by group position.
+        std::vector<int> stillActive;
+        for (size_t a = 0; a < active.size(); a++) {
+            const int g = active[a];
+            const double max = maxError(n, &errors[g * n]);
+            group[g]->env.debugLog.printf("sweep iteration %d: max scaled "
+                                          "error %e\n", iteration, max);
+            if (max < 1.0) {
+                converged[g] = true;
+                group[g]->env.debugLog.printf("sweep converged in %d "
+                                              "iterations\n", iteration);
+            } else if (max < HUGE_VAL) {
+                stillActive.push_back(g);
+            }
+        }
+        active = stillActive;
+        if (active.empty() || iteration == SWEEP_MAX_ITERS) {
+            break;
+        }
+        const int numActive = active.size();
+        // Jacobian one column (variable) at a time for every State at once.
+        for (int j = 0; j < n; j++) {
+            std::vector<double> h(numActive);
+            for (int a = 0; a < numActive; a++) {
+                double *x = &vars[active[a] * n];
+                h[a] = SWEEP_FD_STEP * std::max(fabs(x[j]), 1e-3);
+                x[j] += h[a];
+                group[active[a]]->setVariables(x);
+                x[j] -= h[a];
+            }
+            evaluate(group, active, &activeErrors[0]);
+            for (int a = 0; a < numActive; a++) {
+                const int g = active[a];
+                for (int i = 0; i < n; i++) {
+                    jacobian[(g * n + i) * n + j] = 
+                        (activeErrors[a * n + i] - errors[g * n + i]) / h[a];
+                }
+                group[g]->setVariables(&vars[g * n]);
+            }
+        }
+        // Newton steps; States with a singular Jacobian drop out.
+        std::vector<int> stepping;
+        for (int a = 0; a < numActive; a++) {
+            const int g = active[a];
+            std::vector<double> A(jacobian.begin() + g * n * n, 
+                                  jacobian.begin() + (g + 1) * n * n);
+            std::vector<double> b(n);
+            for (int i = 0; i < n; i++) {
+                b[i] = -errors[g * n + i];
+            }
+            if (solveLinear(n, A, b)) {
+                std::copy(b.begin(), b.end(), step.begin() + g * n);
+                stepping.push_back(g);
+            } else {
+                group[g]->env.debugLog.printf("sweep: singular Jacobian\n");
+            }
+        }
+        // Take the steps, halving those which don't lower the error.
+        active.clear();
+        for (int tries = 0; tries <= SWEEP_BACKTRACKS && !stepping.empty(); 
+             tries++) {
+            for (size_t a = 0; a < stepping.size(); a++) {
+                const int g = stepping[a];
+                std::vector<double> trial(n);
+                for (int i = 0; i < n; i++) {
+                    trial[i] = vars[g * n + i] + step[g * n + i];
+                }
+                group[g]->setVariables(&trial[0]);
+            }
+            evaluate(group, stepping, &activeErrors[0]);
+            std::vector<int> retry;
+            for (size_t a = 0; a < stepping.size(); a++) {
+                const int g = stepping[a];
+                if (maxError(n, &activeErrors[a * n]) 
+                    < maxError(n, &errors[g * n])) {
+                    group[g]->getVariables(&vars[g * n]);
+                    std::copy(activeErrors.begin() + a * n, 
+                              activeErrors.begin() + (a + 1) * n,
+                              errors.begin() + g * n);
+                    active.push_back(g);
+                } else {
+                    for (int i = 0; i < n; i++) {
+                        step[g * n + i] /= 2.0;
+                    }
+                    group[g]->setVariables(&vars[g * n]);
+                    retry.push_back(g);
+                }
+            }
+            stepping = retry;
+        }
+        if (active.empty()) {
+            break;
+        }
+        std::sort(active.begin(), active.end());
+    }
+    return true;
+}
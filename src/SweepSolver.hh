@@ -0,0 +1,61 @@
+/*
+  Copyright (c) 2011 Timothy Lovorn
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#ifndef __SCSS_SWEEP_SOLVER_H
+#define __SCSS_SWEEP_SOLVER_H
+
+#include <vector>
+
+#include "BaseState.hh"
+
+// Give up on lockstep Newton after this many steps.
+#define SWEEP_MAX_ITERS 50
+// Halve a step at most this many times looking for a smaller error.
+#define SWEEP_BACKTRACKS 8
+// Relative size of finite-difference steps for the Jacobian.
+#define SWEEP_FD_STEP 1e-6
+
+// Solves many related States (a parameter sweep) together.  States of the
+// same class on the same grid advance in lockstep by Newton's method, with
+// a finite-difference Jacobian: every evaluation of their errors is one 
+// BaseState::batchScaledErrors traversal for the whole group, so the grid
+// is walked once per evaluation instead of once per State.  Any State 
+// which can't be batched or doesn't converge that way is put back where it
+// started and gets its own makeSelfConsistent.
+class SweepSolver {
+public:
+    // states must outlive the solver.
+    SweepSolver(const std::vector<BaseState*>& states);
+    // Make all the States self-consistent.  Return false if any failed.
+    bool solve();
+private:
+    // Lockstep Newton over group.  Set converged[i] for group[i].  Return
+    // false if the group couldn't be batched at all.
+    bool solveGroup(const std::vector<BaseState*>& group, 
+                    std::vector<bool>& converged);
+    // Scaled errors of the States at index of group, in one traversal.
+    bool evaluate(const std::vector<BaseState*>& group, 
+                  const std::vector<int>& index, double *errors);
+    std::vector<BaseState*> myStates;
+};
+
+#endif
@@ -0,0 +1,118 @@
+/*
+  Copyright (c) 2011 Timothy Lovorn
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cmath>
+
+#include "TriangleBZone.hh"
+
+void TriangleBZone::integrate(const double *e, const double *f, int numF,
+                              double *out, TriangleWeight weight, 
+                              TriangleMoments moments, double param, 
+                              double sharpWidth) {
+    // Sort the corners by energy: e1 <= e2 <= e3.
+    int order[3] = {0, 1, 2};
+    if (e[order[1]] < e[order[0]]) {
+        std::swap(order[0], order[1]);
+    }
+    if (e[order[2]] < e[order[1]]) {
+        std::swap(order[1], order[2]);
+    }
+    if (e[order[1]] < e[order[0]]) {
+        std::swap(order[0], order[1]);
+    }
+    const double e1 = e[order[0]], e2 = e[order[1]], e3 = e[order[2]];
+    const double spread = e3 - e1;
+    if (spread <= 0.0) {
+        const double h = weight(e1, param);
+        for (int i = 0; i < numF; i++) {
+            out[i] = h * (f[3 * i] + f[3 * i + 1] + f[3 * i + 2]) / 3.0;
+        }
+        return;
+    }
+    // Between e1 and e2, a fraction 2 (lower / spread) t dt of the triangle
+    // has t = (e - e1) / lower, and f averages f1 + slope t along that 
+    // level line.  Between e2 and e3 it's the same going down from e3.
+    const double lower = e2 - e1, upper = e3 - e2;
+    double fc[TRIANGLE_MAX_FACTORS], slope[TRIANGLE_MAX_FACTORS];
+    for (int i = 0; i < numF; i++) {
+        out[i] = 0.0;
+    }
+    if (lower > 0.0) {
+        for (int i = 0; i < numF; i++) {
+            const double *fi = &f[3 * i];
+            fc[i] = fi[order[0]];
+            slope[i] = 0.5 * ((fi[order[1]] - fc[i]) 
+                              + (fi[order[2]] - fc[i]) * lower / spread);
+        }
+        piece(e1, e2, fc, slope, numF, 2.0 * lower / spread, out, 
+              weight, moments, param, sharpWidth);
+    }
+    if (upper > 0.0) {
+        for (int i = 0; i < numF; i++) {
+            const double *fi = &f[3 * i];
+            fc[i] = fi[order[2]];
+            slope[i] = 0.5 * ((fi[order[1]] - fc[i]) 
+                              + (fi[order[0]] - fc[i]) * upper / spread);
+        }
+        piece(e3, e2, fc, slope, numF, 2.0 * upper / spread, out, 
+              weight, moments, param, sharpWidth);
+    }
+}
+
+void TriangleBZone::piece(double ec, double eEnd, const double *fc, 
+                          const double *slope, int numF, double scale, 
+                          double *out, TriangleWeight weight, 
+                          TriangleMoments moments, double param, 
+                          double sharpWidth) {
+    static const double node[4] = {0.069431844202973712, 
+                                   0.33000947820757187,
+                                   0.66999052179242813, 
+                                   0.93056815579702629};
+    static const double gaussWeight[4] = {0.17392742256872693, 
+                                          0.32607257743127307,
+                                          0.32607257743127307, 
+                                          0.17392742256872693};
+    const double width = eEnd - ec,
+                 a = std::min(ec, eEnd), b = std::max(ec, eEnd),
+                 distance = a > 0.0 ? a : (b < 0.0 ? -b : 0.0);
+    // Integrate h(e) t^n dt for n = 1, 2.
+    double tMoment = 0.0, t2Moment = 0.0;
+    if (fabs(width) < TRIANGLE_GAUSS_RATIO * std::max(distance, sharpWidth)) {
+        for (int j = 0; j < 4; j++) {
+            const double t = node[j], 
+                         wh = gaussWeight[j] * weight(ec + width * t, param);
+            tMoment += wh * t;
+            t2Moment += wh * t * t;
+        }
+    } else {
+        double M[3];
+        moments(a, b, param, M);
+        const double sign = b == eEnd ? 1.0 : -1.0;
+        tMoment = sign * (M[1] - ec * M[0]) / (width * width);
+        t2Moment = sign * (M[2] - 2.0 * ec * M[1] + ec * ec * M[0]) 
+                   / (width * width * width);
+    }
+    for (int i = 0; i < numF; i++) {
+        out[i] += scale * (fc[i] * tMoment + slope[i] * t2Moment);
+    }
+}
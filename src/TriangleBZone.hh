@@ -0,0 +1,141 @@
+/*
+  Copyright (c) 2011 Timothy Lovorn
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#ifndef __SCSS_TRIANGLE_BZONE_H
+#define __SCSS_TRIANGLE_BZONE_H
+
+#include <vector>
+
+#include "BaseState.hh"
+#include "KGrid.hh"
+
+// The moments are differences of nearly equal antiderivatives when the 
+// energy range is narrow next to the scale h varies on, so ranges narrower
+// than this fraction of that scale use Gauss-Legendre quadrature instead.
+#define TRIANGLE_GAUSS_RATIO 0.25
+// Most factors TriangleBZone::integrate takes at once.
+#define TRIANGLE_MAX_FACTORS 4
+
+// A weight h(e) of the interpolated energy, given pointwise and by its 
+// moments over [a, b]: moments[m] = integral_a^b e^m h(e) de, m = 0, 1, 2.
+// param is whatever else h depends on (fixed over a triangle).
+typedef double (*TriangleWeight)(double e, double param);
+typedef void (*TriangleMoments)(double a, double b, double param, 
+                                double *moments);
+
+// Linear triangle integration over the Brillouin zone.  Each cell of the
+// full grid is cut into two triangles, and the energy e(k) and the factor 
+// f(k) multiplying h(e(k)) are interpolated linearly between the corners.
+// The integral over a triangle then reduces to 1D integrals of h(e) times
+// a quadratic in e, which the moments give exactly; for a step function h
+// that's the occupied fraction of the triangle.  Sharp edges in h cost 
+// O(1/N^2) this way instead of the O(1/N) of a plain grid sum.
+class TriangleBZone {
+public:
+    // Average numValues quantities over the zone.  vertexFunc stores 
+    // numVertexValues numbers about a grid point; triangleFunc gets them 
+    // for the three corners of a triangle and stores the averages of the
+    // quantities over it (generally using integrate).  Rows of cells are 
+    // summed in order, so results don't depend on env.numThreads.  Only
+    // KGRID_SYM_INVERSION is used from symmetry: with it (and an even 
+    // gridLen), half of the cells are visited and counted twice.
+    template <class SpecializedState>
+    static void averages(const BaseState& stBase, 
+        const SpecializedState& stSpec, 
+        void (*vertexFunc)(const SpecializedState&, const KPoint&, double*),
+        int numVertexValues,
+        void (*triangleFunc)(const SpecializedState&, const double* const*, 
+                             double*),
+        int numValues, double *out, int symmetry = KGRID_SYM_NONE);
+    // Averages over a triangle of h(e) f for numF (up to 
+    // TRIANGLE_MAX_FACTORS) factors f, given e and the factors at its 
+    // corners: factor i at corner c is f[3 * i + c].
+    // h must be smooth apart from within about sharpWidth of e = 0.
+    static void integrate(const double *e, const double *f, int numF,
+                          double *out, TriangleWeight weight, 
+                          TriangleMoments moments, double param, 
+                          double sharpWidth);
+private:
+    // Add to out the part of integrate's averages from energies between a
+    // corner's energy ec and eEnd, where h(e) dt is weighted by 
+    // scale t (fc[i] + slope[i] t) with t = (e - ec) / (eEnd - ec).
+    static void piece(double ec, double eEnd, const double *fc, 
+                      const double *slope, int numF, double scale, 
+                      double *out, TriangleWeight weight, 
+                      TriangleMoments moments, double param, 
+                      double sharpWidth);
+};
+
+template <class SpecializedState>
+void TriangleBZone::averages(const BaseState& stBase, 
+        const SpecializedState& stSpec, 
+        void (*vertexFunc)(const SpecializedState&, const KPoint&, double*),
+        int numVertexValues,
+        void (*triangleFunc)(const SpecializedState&, const double* const*, 
+                             double*),
+        int numValues, double *out, int symmetry) {
+    const int N = stBase.getGridLen();
+    // k -> -k takes the cells of row iy to those of row N - 1 - iy, and
+    // each triangle to one of the same shape.
+    const int numRows = (symmetry & KGRID_SYM_INVERSION) && N % 2 == 0 
+                        ? N / 2 : N;
+    const KGrid& grid = KGrid::forGridLen(N);
+    std::vector<double> vertices(grid.numPoints * numVertexValues);
+    #pragma omp parallel for num_threads(stBase.env.passThreads()) \
+                             schedule(static)
+    for (int k = 0; k < grid.numPoints; k++) {
+        vertexFunc(stSpec, KPoint(grid, k), &vertices[k * numVertexValues]);
+    }
+    std::vector<double> rowSums(numRows * numValues, 0.0);
+    #pragma omp parallel for num_threads(stBase.env.passThreads()) \
+                             schedule(static)
+    for (int iy = 0; iy < numRows; iy++) {
+        std::vector<double> terms(numValues);
+        const double *corners[3];
+        const int nextRow = ((iy + 1) % N) * N;
+        for (int ix = 0; ix < N; ix++) {
+            const int nextX = (ix + 1) % N;
+            const double *p00 = &vertices[(iy * N + ix) * numVertexValues],
+                *p10 = &vertices[(iy * N + nextX) * numVertexValues],
+                *p01 = &vertices[(nextRow + ix) * numVertexValues],
+                *p11 = &vertices[(nextRow + nextX) * numVertexValues];
+            for (int t = 0; t < 2; t++) {
+                corners[0] = p00;
+                corners[1] = t == 0 ? p10 : p11;
+                corners[2] = t == 0 ? p11 : p01;
+                triangleFunc(stSpec, corners, &terms[0]);
+                for (int v = 0; v < numValues; v++) {
+                    rowSums[iy * numValues + v] += terms[v];
+                }
+            }
+        }
+    }
+    for (int v = 0; v < numValues; v++) {
+        double sum = 0.0;
+        for (int iy = 0; iy < numRows; iy++) {
+            sum += rowSums[iy * numValues + v];
+        }
+        out[v] = sum / (2.0 * N * numRows);
+    }
+}
+
+#endif
@@ -20,6 +20,8 @@
   THE SOFTWARE.
 */
 
+#include <sys/time.h>
+
 #include "Utility.hh"
 
 std::string Utility::joinPath(const std::string& path,
@@ -33,3 +35,9 @@ std::string Utility::joinPath(const std::string& path,
     finalPath.append(fileName);
     return finalPath;
 }
+
+double Utility::wallTime() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
@@ -29,6 +29,8 @@ class Utility {
 public:
     static std::string joinPath(const std::string& path, 
                                 const std::string& fileName);
+    // Wall clock time in seconds, for timing things.
+    static double wallTime();
 };
 
 #endif
@@ -0,0 +1,65 @@
+/*
+  Copyright (c) 2011 Timothy Lovorn
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#ifndef __SCSS_VECTORIZE_H
+#define __SCSS_VECTORIZE_H
+
+// Batch kernels marked SCSS_TARGET_CLONES are compiled once per instruction
+// set listed here and the best one the CPU supports is picked when the 
+// program loads.  Plain x86-64 ("default") already means SSE2.  Other
+// compilers and architectures just get the default build; defining 
+// SCSS_NO_TARGET_CLONES turns dispatch off everywhere.
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) \
+    && !defined(SCSS_NO_TARGET_CLONES)
+#define SCSS_TARGET_CLONES \
+    __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define SCSS_TARGET_CLONES
+#endif
+
+// Per-point helpers called inside a batch kernel's simd loop are forced
+// inline, so the loop still vectorizes in every clone.
+#if defined(__GNUC__)
+#define SCSS_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define SCSS_ALWAYS_INLINE inline
+#endif
+
+// Single-precision batch kernels reduce blocks of this many points in 
+// float lanes, then add the block sums with KahanFloat, so rounding error
+// doesn't grow with the row length.
+#define SCSS_FLOAT_BLOCK 64
+
+// Compensated (Kahan) sum of floats.  Only correct if the compiler isn't
+// allowed to reassociate (no -ffast-math).
+struct KahanFloat {
+    KahanFloat() : sum(0.0f), carry(0.0f) { }
+    void add(float x) {
+        const float y = x - carry;
+        const float t = sum + y;
+        carry = (t - sum) - y;
+        sum = t;
+    }
+    float sum, carry;
+};
+
+#endif
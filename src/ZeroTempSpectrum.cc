@@ -20,35 +20,35 @@
   THE SOFTWARE.
 */
 
+#include <algorithm>
+#include <cfloat>
+
 #include "ZeroTempSpectrum.hh"
 
-double ZeroTempSpectrum::epsilon(const ZeroTempState& st, double kx, 
-                                 double ky) {
-    return epsilonBar(st, kx, ky) - st.getEpsilonMin();
+double ZeroTempSpectrum::epsilon(const ZeroTempState& st, const KPoint& k) {
+    return epsilonBar(st, k) - st.getEpsilonMin();
 }
 
-double ZeroTempSpectrum::epsilonBar(const ZeroTempState& st, double kx, 
-                                    double ky) {
+double ZeroTempSpectrum::epsilonBar(const ZeroTempState& st, 
+                                    const KPoint& k) {
     const ZeroTempEnvironment& env = st.env;
-    const double sx = sin(kx);
-    const double sy = sin(ky);
-    return 2.0 * env.th * ((sx + sy) * (sx + sy) - 1.0)
-         + 4.0 * (st.getD1() * env.t0 - env.thp) * sx * sy;
+    return 2.0 * env.th * k.epsA
+         + 4.0 * (st.getD1() * env.t0 - env.thp) * k.epsB;
 }
 
-double ZeroTempSpectrum::xi(const ZeroTempState& st, double kx, double ky) {
-    return epsilon(st, kx, ky) - st.getMu();
+double ZeroTempSpectrum::xi(const ZeroTempState& st, const KPoint& k) {
+    return epsilon(st, k) - st.getMu();
 }
 
-double ZeroTempSpectrum::delta(const ZeroTempState& st, double kx, double ky) {
+double ZeroTempSpectrum::delta(const ZeroTempState& st, const KPoint& k) {
     return 4.0 * st.getF0() * (st.env.t0 + st.env.tz)
-               * (sin(kx) + st.env.alpha * sin(ky));
+               * (k.sinX + st.env.alpha * k.sinY);
 }
 
-double ZeroTempSpectrum::pairEnergy(const ZeroTempState& st, double kx, 
-                                    double ky) {
-    const double xi_k = xi(st, kx, ky);
-    const double delta_k = delta(st, kx, ky);
+double ZeroTempSpectrum::pairEnergy(const ZeroTempState& st, 
+                                    const KPoint& k) {
+    const double xi_k = xi(st, k);
+    const double delta_k = delta(st, k);
     return sqrt(xi_k * xi_k + delta_k * delta_k);
 }
 
@@ -61,18 +61,162 @@ double ZeroTempSpectrum::fermi(const ZeroTempState& st, double energy) {
     }
 }
 
-double ZeroTempSpectrum::innerD1(const ZeroTempState& st, double kx, 
-                                 double ky) {
-    return -0.5*(1 - xi(st, kx, ky)/pairEnergy(st, kx, ky)) * sin(kx)*sin(ky);
+double ZeroTempSpectrum::innerD1(const ZeroTempState& st, const KPoint& k) {
+    return -0.5 * (1 - xi(st, k) / pairEnergy(st, k)) * k.epsB;
+}
+
+double ZeroTempSpectrum::innerMu(const ZeroTempState& st, const KPoint& k) {
+    return 0.5 * (1 - xi(st, k) / pairEnergy(st, k));
+}
+
+double ZeroTempSpectrum::innerF0(const ZeroTempState& st, const KPoint& k) {
+    const double sin_part = k.sinX + st.env.alpha * k.sinY;
+    return sin_part * sin_part / pairEnergy(st, k);
+}
+
+void ZeroTempSpectrum::innerAll(const ZeroTempState& st, const KPoint& k,
+                                double *terms) {
+    const double xi_k = xi(st, k);
+    const double delta_k = delta(st, k);
+    const double energy = sqrt(xi_k * xi_k + delta_k * delta_k);
+    const double sin_part = k.sinX + st.env.alpha * k.sinY;
+    const double occupation = 0.5 * (1 - xi_k / energy);
+    terms[0] = -occupation * k.epsB;
+    terms[1] = occupation;
+    terms[2] = sin_part * sin_part / energy;
+}
+
+SCSS_TARGET_CLONES
+void ZeroTempSpectrum::innerAllBatch(const ZeroTempState& st, 
+                                     const KGrid& grid, int begin, int end, 
+                                     double *sums) {
+    const ZeroTempEnvironment& env = st.env;
+    const double coeffA = 2.0 * env.th, 
+                 coeffB = 4.0 * (st.getD1() * env.t0 - env.thp),
+                 epsilonMin = st.getEpsilonMin(), mu = st.getMu(),
+                 deltaScale = 4.0 * st.getF0() * (env.t0 + env.tz),
+                 alpha = env.alpha;
+    const double *sinX = &grid.sinX[0], *sinY = &grid.sinY[0],
+                 *epsA = &grid.epsA[0], *epsB = &grid.epsB[0],
+                 *weight = &grid.weight[0];
+    double sumD1 = 0.0, sumMu = 0.0, sumF0 = 0.0;
+    #pragma omp simd reduction(+:sumD1,sumMu,sumF0)
+    for (int k = begin; k < end; k++) {
+        const double xi_k = coeffA * epsA[k] + coeffB * epsB[k] 
+                            - epsilonMin - mu;
+        const double sin_part = sinX[k] + alpha * sinY[k];
+        const double delta_k = deltaScale * sin_part;
+        const double energy = sqrt(xi_k * xi_k + delta_k * delta_k);
+        const double occupation = 0.5 * (1 - xi_k / energy);
+        sumD1 += weight[k] * (-occupation * epsB[k]);
+        sumMu += weight[k] * occupation;
+        sumF0 += weight[k] * (sin_part * sin_part / energy);
+    }
+    sums[0] = sumD1;
+    sums[1] = sumMu;
+    sums[2] = sumF0;
+}
+
+// Mirrors innerAllBatch; the shift epsilonMin + mu is taken in double first.
+SCSS_TARGET_CLONES
+void ZeroTempSpectrum::innerAllBatchFloat(const ZeroTempState& st, 
+                                          const KGrid& grid, int begin, 
+                                          int end, double *sums) {
+    const ZeroTempEnvironment& env = st.env;
+    const float coeffA = 2.0 * env.th, 
+                coeffB = 4.0 * (st.getD1() * env.t0 - env.thp),
+                shift = st.getEpsilonMin() + st.getMu(),
+                deltaScale = 4.0 * st.getF0() * (env.t0 + env.tz),
+                alpha = env.alpha;
+    const float *sinX = &grid.sinXf[0], *sinY = &grid.sinYf[0],
+                *epsA = &grid.epsAf[0], *epsB = &grid.epsBf[0],
+                *weight = &grid.weightf[0];
+    KahanFloat sumD1, sumMu, sumF0;
+    for (int block = begin; block < end; block += SCSS_FLOAT_BLOCK) {
+        const int blockEnd = std::min(block + SCSS_FLOAT_BLOCK, end);
+        float blockD1 = 0.0f, blockMu = 0.0f, blockF0 = 0.0f;
+        #pragma omp simd reduction(+:blockD1,blockMu,blockF0)
+        for (int k = block; k < blockEnd; k++) {
+            const float xi_k = coeffA * epsA[k] + coeffB * epsB[k] - shift;
+            const float sin_part = sinX[k] + alpha * sinY[k];
+            const float delta_k = deltaScale * sin_part;
+            const float energy = sqrtf(xi_k * xi_k + delta_k * delta_k);
+            const float occupation = 0.5f * (1.0f - xi_k / energy);
+            blockD1 += weight[k] * (-occupation * epsB[k]);
+            blockMu += weight[k] * occupation;
+            blockF0 += weight[k] * (sin_part * sin_part / energy);
+        }
+        sumD1.add(blockD1);
+        sumMu.add(blockMu);
+        sumF0.add(blockF0);
+    }
+    sums[0] = sumD1.sum;
+    sums[1] = sumMu.sum;
+    sums[2] = sumF0.sum;
+}
+
+void ZeroTempSpectrum::triangleVertex(const ZeroTempState& st, 
+                                      const KPoint& k, double *values) {
+    const double sin_part = k.sinX + st.env.alpha * k.sinY,
+                 delta_k = delta(st, k);
+    values[0] = xi(st, k);
+    values[1] = delta_k * delta_k;
+    values[2] = -k.epsB;
+    values[3] = sin_part * sin_part;
+}
+
+void ZeroTempSpectrum::triangleAll(const ZeroTempState& st, 
+                                   const double* const *corners, 
+                                   double *terms) {
+    // Factors of the occupation, {-epsB, 1}, and of 1 / pairEnergy.
+    double xi_k[3], occupationFactors[6], sinSquared[3];
+    double delta2 = 0.0;
+    for (int c = 0; c < 3; c++) {
+        xi_k[c] = corners[c][0];
+        delta2 += corners[c][1] / 3.0;
+        occupationFactors[c] = corners[c][2];
+        occupationFactors[3 + c] = 1.0;
+        sinSquared[c] = corners[c][3];
+    }
+    // Both weights only change quickly within about delta of xi = 0.
+    const double width = sqrt(delta2);
+    TriangleBZone::integrate(xi_k, occupationFactors, 2, terms, occupation,
+                             occupationMoments, delta2, width);
+    TriangleBZone::integrate(xi_k, sinSquared, 1, &terms[2], inverseEnergy,
+                             inverseEnergyMoments, delta2, width);
+}
+
+double ZeroTempSpectrum::occupation(double xi, double delta2) {
+    const double energy = sqrt(xi * xi + delta2);
+    return energy > 0.0 ? 0.5 * (1.0 - xi / energy) : 0.5;
+}
+
+// delta2 * asinh(xi / delta), which goes to 0 with delta2.
+static double scaledAsinh(double xi, double delta2) {
+    return delta2 > 0.0 ? delta2 * asinh(xi / sqrt(delta2)) : 0.0;
+}
+
+void ZeroTempSpectrum::occupationMoments(double a, double b, double delta2,
+                                         double *moments) {
+    const double Ea = sqrt(a * a + delta2), Eb = sqrt(b * b + delta2);
+    moments[0] = 0.5 * ((b - Eb) - (a - Ea));
+    moments[1] = 0.25 * ((b * b - b * Eb + scaledAsinh(b, delta2))
+                         - (a * a - a * Ea + scaledAsinh(a, delta2)));
+    moments[2] = ((b * b * b - Eb * Eb * Eb) - (a * a * a - Ea * Ea * Ea)) 
+                 / 6.0 + 0.5 * delta2 * (Eb - Ea);
 }
 
-double ZeroTempSpectrum::innerMu(const ZeroTempState& st, double kx, 
-                                 double ky) {
-    return 0.5 * (1 - xi(st, kx, ky)/pairEnergy(st, kx, ky));
+double ZeroTempSpectrum::inverseEnergy(double xi, double delta2) {
+    return 1.0 / sqrt(xi * xi + std::max(delta2, DBL_MIN));
 }
 
-double ZeroTempSpectrum::innerF0(const ZeroTempState& st, double kx, 
-                                 double ky) {
-    const double sin_part = sin(kx) + st.env.alpha * sin(ky);
-    return sin_part * sin_part / pairEnergy(st, kx, ky);
+void ZeroTempSpectrum::inverseEnergyMoments(double a, double b, 
+                                            double delta2, double *moments) {
+    // 1 / E has a log singularity at xi = 0 when delta2 = 0; keep it finite.
+    const double d2 = std::max(delta2, DBL_MIN), delta = sqrt(d2),
+                 Ea = sqrt(a * a + d2), Eb = sqrt(b * b + d2),
+                 asinhA = asinh(a / delta), asinhB = asinh(b / delta);
+    moments[0] = asinhB - asinhA;
+    moments[1] = Eb - Ea;
+    moments[2] = 0.5 * ((b * Eb - d2 * asinhB) - (a * Ea - d2 * asinhA));
 }
@@ -26,25 +26,58 @@
 #include <cmath>
 
 #include "ZeroTempState.hh"
+#include "KGrid.hh"
+#include "Vectorize.hh"
+#include "TriangleBZone.hh"
 
 class ZeroTempSpectrum {
 public:
     // One-hole spectrum to be used, minimum at 0
-    static double epsilon(const ZeroTempState& st, double kx, double ky);
+    static double epsilon(const ZeroTempState& st, const KPoint& k);
     // One-hole spectrum unmodified from theory
-    static double epsilonBar(const ZeroTempState& st, double kx, double ky);
+    static double epsilonBar(const ZeroTempState& st, const KPoint& k);
     // One-hole energy, epsilon - mu
-    static double xi(const ZeroTempState& st, double kx, double ky);
+    static double xi(const ZeroTempState& st, const KPoint& k);
     // Superconducting gap
-    static double delta(const ZeroTempState& st, double kx, double ky);
+    static double delta(const ZeroTempState& st, const KPoint& k);
     // Energy of a superconducting pair
-    static double pairEnergy(const ZeroTempState& st, double kx, double ky);
+    static double pairEnergy(const ZeroTempState& st, const KPoint& k);
     // Fermi distribution function (for T=0)
     static double fermi(const ZeroTempState& st, double energy);
     // term to be summed to calculate rhs of associated S-C equation
-    static double innerD1(const ZeroTempState& st, double kx, double ky);
-    static double innerMu(const ZeroTempState& st, double kx, double ky);
-    static double innerF0(const ZeroTempState& st, double kx, double ky);
+    static double innerD1(const ZeroTempState& st, const KPoint& k);
+    static double innerMu(const ZeroTempState& st, const KPoint& k);
+    static double innerF0(const ZeroTempState& st, const KPoint& k);
+    // all three terms at once, sharing xi and pairEnergy:
+    // terms = {innerD1, innerMu, innerF0}
+    static void innerAll(const ZeroTempState& st, const KPoint& k, 
+                         double *terms);
+    // Weighted sums of innerAll's terms over grid points [begin, end), 
+    // computed straight from the grid arrays so the loop vectorizes.
+    static void innerAllBatch(const ZeroTempState& st, const KGrid& grid, 
+                              int begin, int end, double *sums);
+    // Same sums in single precision (see SCSS_FLOAT_BLOCK), for early
+    // iterations where twice the SIMD width matters more than accuracy.
+    static void innerAllBatchFloat(const ZeroTempState& st, 
+                                   const KGrid& grid, int begin, int end, 
+                                   double *sums);
+    // Triangle integration (see TriangleBZone).  Per grid point: 
+    // {xi, delta^2, -epsB, sin_part^2}.
+    static void triangleVertex(const ZeroTempState& st, const KPoint& k,
+                               double *values);
+    // innerAll's terms averaged over a triangle, with xi and the factors
+    // multiplying the occupation or 1 / pairEnergy interpolated linearly,
+    // and delta^2 replaced by its mean over the corners.
+    static void triangleAll(const ZeroTempState& st, 
+                            const double* const *corners, double *terms);
+    // Occupation 0.5 (1 - xi / E) and 1 / E, with E^2 = xi^2 + delta2, and
+    // their moments over xi in [a, b] (for TriangleBZone::integrate).
+    static double occupation(double xi, double delta2);
+    static void occupationMoments(double a, double b, double delta2, 
+                                  double *moments);
+    static double inverseEnergy(double xi, double delta2);
+    static void inverseEnergyMoments(double a, double b, double delta2,
+                                     double *moments);
 };
 
 #endif
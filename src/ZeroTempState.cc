@@ -20,6 +20,8 @@
   THE SOFTWARE.
 */
 
+#include <algorithm>
+
 #include "ZeroTempState.hh"
 
 ZeroTempState::ZeroTempState(const ZeroTempEnvironment& envIn) : 
@@ -28,21 +30,79 @@ ZeroTempState::ZeroTempState(const ZeroTempEnvironment& envIn) :
     setEpsilonMin();
 }
 // driver
-bool ZeroTempState::makeSelfConsistent() {
-    do {
+bool ZeroTempState::solve() {
+    if (env.solverMode == "coupled") {
+        if (fixCoupled() && checkSelfConsistent()) {
+            return true;
+        }
+        env.errorLog.printf("Coupled solve failed, using nested solve.\n");
+    }
+    std::vector<double> weights(3);
+    weights[0] = 1.0 / env.tolD1;
+    weights[1] = 1.0 / env.tolMu;
+    weights[2] = 1.0 / env.tolF0;
+    AndersonMixer mixer(3, env.andersonDepth, weights);
+    outerIterations = 0;
+    startPrecision();
+    bool converged = false;
+    while (!converged && outerIterations < outerMaxIters) {
+        std::vector<double> start(3);
+        start[0] = d1;
+        start[1] = mu;
+        start[2] = f0;
         fixD1();
         env.debugLog.printf("got d1 = %e\n", d1);
         fixMu();
         env.debugLog.printf("got mu = %e\n", mu);
         fixF0();
         env.debugLog.printf("got f0 = %e\n", f0);
-    } while (!checkSelfConsistent());
-    return checkSelfConsistent();
+        outerIterations++;
+        // Check before mixing: the mixed values don't each solve their own
+        // equation the way the plain step's values do.
+        // Errors from the single-precision kernels can't show convergence.
+        converged = !lowPrecision && checkSelfConsistent();
+        if (lowPrecision) {
+            updatePrecision(maxScaledError(), &ZeroTempState::gridTerms, 3);
+        }
+        if (!converged && env.mixingMode == "anderson") {
+            std::vector<double> step(3);
+            step[0] = d1;
+            step[1] = mu;
+            step[2] = f0;
+            const std::vector<double> next = mixer.mix(start, step);
+            if (next[2] >= 0.0) {
+                d1 = next[0];
+                mu = next[1];
+                f0 = next[2];
+                setEpsilonMin();
+                env.debugLog.printf("mixed to d1 = %e, mu = %e, f0 = %e\n",
+                                    d1, mu, f0);
+            } else {
+                // Mixed values are out of range; keep the plain step.
+                mixer.reset();
+            }
+        }
+    }
+    lowPrecision = false;
+    if (!converged) {
+        env.errorLog.printf("Outer loop failed to converge!\n");
+    }
+    const int plainIterations = mixer.estimatePlainSteps();
+    outerIterationsSaved = plainIterations > outerIterations ? 
+                           plainIterations - outerIterations : 0;
+    env.debugLog.printf("outer iterations = %d, saved by mixing = %d\n", 
+                        outerIterations, outerIterationsSaved);
+    return converged;
 }
 
 // checkers
 bool ZeroTempState::checkSelfConsistent() const {
-    return checkD1() && checkMu() && checkF0();
+    return checkSelfConsistent(absErrors());
+}
+
+bool ZeroTempState::checkSelfConsistent(const ZeroTempErrors& errors) const {
+    return fabs(errors.d1) < env.tolD1 && fabs(errors.mu) < env.tolMu
+        && fabs(errors.f0) < env.tolF0;
 }
 
 bool ZeroTempState::checkF0() const {
@@ -52,44 +112,127 @@ bool ZeroTempState::checkF0() const {
 // error calculators
 double ZeroTempState::absErrorD1() const {
     double lhs = d1;
-    double rhs = BZone::average<ZeroTempState>(*this, *this, 
-                                               ZeroTempSpectrum::innerD1);
+    double rhs;
+    if (separateSums()) {
+        rhs = BZone::average<ZeroTempState>(*this, *this, 
+                                            ZeroTempSpectrum::innerD1,
+                                            termSymmetry());
+    } else {
+        double terms[3];
+        averageTerms(terms);
+        rhs = terms[0];
+    }
     return lhs - rhs;
 }
 
 double ZeroTempState::absErrorMu() const {
     double lhs = env.x;
-    double rhs = BZone::average<ZeroTempState>(*this, *this,
-                                               ZeroTempSpectrum::innerMu);
+    double rhs;
+    if (separateSums()) {
+        rhs = BZone::average<ZeroTempState>(*this, *this, 
+                                            ZeroTempSpectrum::innerMu,
+                                            termSymmetry());
+    } else {
+        double terms[3];
+        averageTerms(terms);
+        rhs = terms[1];
+    }
     return lhs - rhs;
 }
 
 double ZeroTempState::absErrorF0() const {
     double lhs = 1.0 / (env.t0 + env.tz);
-    double rhs = BZone::average<ZeroTempState>(*this, *this,
-                                               ZeroTempSpectrum::innerF0);
+    double rhs;
+    if (separateSums()) {
+        rhs = BZone::average<ZeroTempState>(*this, *this, 
+                                            ZeroTempSpectrum::innerF0,
+                                            termSymmetry());
+    } else {
+        double terms[3];
+        averageTerms(terms);
+        rhs = terms[2];
+    }
     return lhs - rhs;
 }
 
+void ZeroTempState::averageTerms(double *rhs) const {
+    if (env.bzoneIntegrator == "adaptive") {
+        noteAdaptive(AdaptiveBZone::averages<ZeroTempState>(*this, *this, 
+            ZeroTempSpectrum::innerAll, 3, rhs, NULL, termSymmetry()));
+    } else if (env.bzoneIntegrator == "triangle") {
+        TriangleBZone::averages<ZeroTempState>(*this, *this, 
+            ZeroTempSpectrum::triangleVertex, 4, 
+            ZeroTempSpectrum::triangleAll, 3, rhs, termSymmetry());
+    } else {
+        gridTerms(*this, rhs);
+    }
+}
+
+void ZeroTempState::gridTerms(const BaseState& stBase, double *rhs) {
+    const ZeroTempState& st = (const ZeroTempState&)stBase;
+    if (st.env.kernelMode == "scalar") {
+        BZone::averages<ZeroTempState>(st, st, ZeroTempSpectrum::innerAll, 3, 
+                                       rhs, st.termSymmetry());
+    } else if (st.lowPrecision) {
+        BZone::averagesBatch<ZeroTempState>(st, st, 
+            ZeroTempSpectrum::innerAllBatchFloat, 3, rhs, st.termSymmetry());
+    } else {
+        BZone::averagesBatch<ZeroTempState>(st, st, 
+            ZeroTempSpectrum::innerAllBatch, 3, rhs, st.termSymmetry());
+    }
+}
+
+ZeroTempErrors ZeroTempState::absErrors() const {
+    double rhs[3];
+    averageTerms(rhs);
+    return errorsFromTerms(rhs);
+}
+
+ZeroTempErrors ZeroTempState::errorsFromTerms(const double *rhs) const {
+    ZeroTempErrors errors;
+    errors.d1 = d1 - rhs[0];
+    errors.mu = env.x - rhs[1];
+    errors.f0 = 1.0 / (env.t0 + env.tz) - rhs[2];
+    return errors;
+}
+
+double ZeroTempState::maxScaledError() const {
+    const ZeroTempErrors errors = absErrors();
+    return std::max(std::max(fabs(errors.d1) / env.tolD1, 
+                             fabs(errors.mu) / env.tolMu),
+                    fabs(errors.f0) / env.tolF0);
+}
+
 double ZeroTempState::relErrorD1() const {
-    double error = absErrorD1();
+    return relErrorD1(absErrorD1());
+}
+
+double ZeroTempState::relErrorD1(double error) const {
     if (d1 == 0.0 && error == 0.0) {
         return 0.0;
     }
     else if (d1 == 0.0) {
-        return fabs(d1) / fabs(absErrorD1());
+        return fabs(d1) / fabs(error);
     }
     else {
-        return fabs(absErrorD1()) / fabs(d1);
+        return fabs(error) / fabs(d1);
     }
 }
 
 double ZeroTempState::relErrorMu() const {
-    return fabs(absErrorMu()) / env.x;
+    return relErrorMu(absErrorMu());
+}
+
+double ZeroTempState::relErrorMu(double error) const {
+    return fabs(error) / env.x;
 }
 
 double ZeroTempState::relErrorF0() const {
-    return fabs(absErrorF0()) * (env.t0 + env.tz);
+    return relErrorF0(absErrorF0());
+}
+
+double ZeroTempState::relErrorF0(double error) const {
+    return fabs(error) * (env.t0 + env.tz);
 }
 
 // getters
@@ -99,20 +242,86 @@ double ZeroTempState::getF0() const {
 
 // logging
 void ZeroTempState::logState() const {
-    std::string sc = checkSelfConsistent() ? "true" : "false";
+    const ZeroTempErrors errors = absErrors();
+    std::string sc = checkSelfConsistent(errors) ? "true" : "false";
     env.outputLog.printf("<begin>,state\n");
     env.outputLog.printf("self-consistent,%s\n", sc.c_str());
-    env.outputLog.printf("d1,%e\nd1RelError,%e\n", getD1(), relErrorD1());
-    env.outputLog.printf("mu,%e\nmuRelError,%e\n", getMu(), relErrorMu());
-    env.outputLog.printf("f0,%e\nf0RelError,%e\n", getF0(), relErrorF0());
+    env.outputLog.printf("d1,%e\nd1RelError,%e\n", getD1(), 
+                         relErrorD1(errors.d1));
+    env.outputLog.printf("mu,%e\nmuRelError,%e\n", getMu(), 
+                         relErrorMu(errors.mu));
+    env.outputLog.printf("f0,%e\nf0RelError,%e\n", getF0(), 
+                         relErrorF0(errors.f0));
+    if (env.bzoneIntegrator == "adaptive") {
+        logAdaptive();
+    }
+    if (env.precisionMode == "mixed") {
+        env.outputLog.printf("precisionSwitchIteration,%d\n"
+                             "floatSumError,%e\n", precisionSwitchIteration,
+                             floatSumError);
+    }
+    env.outputLog.printf("outerIterations,%d\nouterIterationsSaved,%d\n",
+                         outerIterations, outerIterationsSaved);
     env.outputLog.printf("<end>,state\n");
 }
 
+// lockstep solving
+int ZeroTempState::numVariables() const {
+    return 3;
+}
+
+void ZeroTempState::getVariables(double *vars) const {
+    vars[0] = d1;
+    vars[1] = mu;
+    vars[2] = f0;
+}
+
+void ZeroTempState::setVariables(const double *vars) {
+    d1 = vars[0];
+    mu = vars[1];
+    f0 = vars[2];
+    setEpsilonMin();    // D1 changed so epsilonMin might change
+}
+
+bool ZeroTempState::batchScaledErrors(
+        const std::vector<const BaseState*>& states, double *errors) const {
+    std::vector<const ZeroTempState*> zeroStates;
+    for (size_t s = 0; s < states.size(); s++) {
+        const ZeroTempState *st = 
+            dynamic_cast<const ZeroTempState*>(states[s]);
+        if (st == NULL || !st->plainBatchSums() 
+            || st->getGridLen() != getGridLen()
+            || st->termSymmetry() != termSymmetry()) {
+            return false;
+        }
+        zeroStates.push_back(st);
+    }
+    std::vector<double> rhs(3 * states.size());
+    BZone::averagesBatchMulti<ZeroTempState>(zeroStates, 
+        ZeroTempSpectrum::innerAllBatch, 3, &rhs[0], termSymmetry());
+    for (size_t s = 0; s < states.size(); s++) {
+        const ZeroTempState& st = *zeroStates[s];
+        const ZeroTempErrors stErrors = st.errorsFromTerms(&rhs[3 * s]);
+        errors[3 * s] = stErrors.d1 / st.env.tolD1;
+        errors[3 * s + 1] = stErrors.mu / st.env.tolMu;
+        errors[3 * s + 2] = stErrors.f0 / st.env.tolF0;
+    }
+    return true;
+}
+
 // variable manipulators
-double ZeroTempState::setEpsilonMin() {
-    epsilonMin = BZone::minimum<ZeroTempState>(*this, *this, 
-                                               ZeroTempSpectrum::epsilonBar);
-    return epsilonMin;
+int ZeroTempState::termSymmetry() const {
+    int symmetry = BaseState::termSymmetry();
+    if (env.alpha != 1 && env.alpha != -1) {
+        symmetry &= ~KGRID_SYM_EXCHANGE;
+    }
+    return symmetry;
+}
+
+double ZeroTempState::gridEpsilonMin() const {
+    return BZone::minimum<ZeroTempState>(*this, *this, 
+                                     ZeroTempSpectrum::epsilonBar,
+                                     termSymmetry());
 }
 
 double ZeroTempState::helperD1(double x, void *params) {
@@ -144,6 +353,8 @@ bool ZeroTempState::fixD1() {
     double old_d1 = d1;
     RootFinder rootFinder(&ZeroTempState::helperD1, this, d1, 
                           0.0, 1.0, env.tolD1 / 10);
+    CoarseBracket coarse(this, &ZeroTempState::helperD1, this);
+    setCoarseBracket(rootFinder, coarse);
     const RootData& rootData = rootFinder.findRoot();
     if (!rootData.converged) {
         env.errorLog.printf("D1 failed to converge!\n");
@@ -157,6 +368,8 @@ bool ZeroTempState::fixMu() {
     double old_mu = mu;
     RootFinder rootFinder(&ZeroTempState::helperMu, this, mu, 
                           -1.0, 1.0, env.tolMu / 10);
+    CoarseBracket coarse(this, &ZeroTempState::helperMu, this);
+    setCoarseBracket(rootFinder, coarse);
     const RootData& rootData = rootFinder.findRoot();
     if (!rootData.converged) {
         env.errorLog.printf("Mu failed to converge!\n");
@@ -170,6 +383,8 @@ bool ZeroTempState::fixF0() {
     double old_f0 = f0;
     RootFinder rootFinder(&ZeroTempState::helperF0, this, f0, 
                           0.0, 1.0, env.tolF0 / 10);
+    CoarseBracket coarse(this, &ZeroTempState::helperF0, this);
+    setCoarseBracket(rootFinder, coarse);
     const RootData& rootData = rootFinder.findRoot();
     if (!rootData.converged) {
         env.errorLog.printf("F0 failed to converge!\n");
@@ -178,3 +393,52 @@ bool ZeroTempState::fixF0() {
     }
     return true;
 }
+
+// Residuals are scaled by their tolerances so that every variable counts the
+// same in the solver's convergence test.
+int ZeroTempState::helperCoupled(const gsl_vector *x, void *params, 
+                                 gsl_vector *f) {
+    ZeroTempState *st = (ZeroTempState*)params;
+    st->d1 = gsl_vector_get(x, 0);
+    st->mu = gsl_vector_get(x, 1);
+    st->f0 = gsl_vector_get(x, 2);
+    st->setEpsilonMin();    // D1 changed so epsilonMin might change
+    const ZeroTempErrors errors = st->absErrors();
+    gsl_vector_set(f, 0, errors.d1 / st->env.tolD1);
+    gsl_vector_set(f, 1, errors.mu / st->env.tolMu);
+    gsl_vector_set(f, 2, errors.f0 / st->env.tolF0);
+    st->env.debugLog.printf("coupled trial d1 = %e, mu = %e, f0 = %e\n", 
+                            st->d1, st->mu, st->f0);
+    if (!(gsl_finite(gsl_vector_get(f, 0)) && gsl_finite(gsl_vector_get(f, 1))
+          && gsl_finite(gsl_vector_get(f, 2)))) {
+        return GSL_EBADFUNC;
+    }
+    return GSL_SUCCESS;
+}
+
+bool ZeroTempState::fixCoupled() {
+    double old_d1 = d1, old_mu = mu, old_f0 = f0;
+    std::vector<double> guess(3);
+    guess[0] = d1;
+    guess[1] = mu;
+    guess[2] = f0;
+    MultiRootFinder rootFinder(&ZeroTempState::helperCoupled, this, guess, 0.1);
+    const MultiRootData& rootData = rootFinder.findRoot();
+    if (!rootData.converged) {
+        env.errorLog.printf("Coupled solve failed to converge after %d "
+                            "iterations!\n", rootData.iterations);
+        d1 = old_d1;
+        mu = old_mu;
+        f0 = old_f0;
+        setEpsilonMin();
+        return false;
+    }
+    d1 = rootData.root[0];
+    mu = rootData.root[1];
+    f0 = rootData.root[2];
+    setEpsilonMin();
+    env.debugLog.printf("coupled solve got d1 = %e, mu = %e, f0 = %e "
+                        "in %d iterations\n", d1, mu, f0, 
+                        rootData.iterations);
+    return true;
+}
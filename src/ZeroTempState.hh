@@ -26,14 +26,18 @@
 #include "BaseState.hh"
 #include "ZeroTempEnvironment.hh"
 #include "RootFinder.hh"
+#include "MultiRootFinder.hh"
+#include "AndersonMixer.hh"
+
+// Absolute errors in all the S-C equations, found with one BZone pass.
+struct ZeroTempErrors {
+    double d1, mu, f0;
+};
 
 class ZeroTempState : public BaseState {
 public:
     // Constructor needs to examine envIn to set member variables.
     ZeroTempState(const ZeroTempEnvironment& envIn);
-    // Drive calculations needed to make this State consistent
-    // with the given Environment.  Return false if unable to converge.
-    bool makeSelfConsistent();
     // Return true is the errors in all self-consistent equations are within
     // their tolerances, false otherwise.
     bool checkSelfConsistent() const;
@@ -44,6 +48,12 @@ public:
     double absErrorD1() const;
     double absErrorMu() const;
     double absErrorF0() const;
+    // All of the above at once.
+    ZeroTempErrors absErrors() const;
+    // Averages of the three S-C sums (ZeroTempSpectrum::innerAll's terms),
+    // evaluated with the kernels picked by env.kernelMode, or adaptively
+    // or over triangles if env.bzoneIntegrator says so.
+    void averageTerms(double *rhs) const;
     // Relative error
     double relErrorD1() const;
     double relErrorMu() const;
@@ -52,6 +62,12 @@ public:
     double getF0() const;
     // Output what state is now.
     void logState() const;
+    // Lockstep solving support; see BaseState.
+    int numVariables() const;
+    void getVariables(double *vars) const;
+    void setVariables(const double *vars);
+    bool batchScaledErrors(const std::vector<const BaseState*>& states,
+                           double *errors) const;
      // RootFinder needs to be a friend to do its dirty work.
     friend class RootFinder;
     // Our Environment, containing all the configuration info we need.
@@ -59,9 +75,19 @@ public:
 protected:
     // Self-consistent variables.
     double f0;
-    // Set epsilonMin to the appropriate value.
-    // -- Need to call this after changing D1! --
-    double setEpsilonMin();
+    // Errors in the S-C equations given the averages from averageTerms.
+    ZeroTempErrors errorsFromTerms(const double *rhs) const;
+    // Largest |error| / tolerance among the S-C equations.
+    double maxScaledError() const;
+    // Versions of the public checkers which reuse already-computed errors.
+    bool checkSelfConsistent(const ZeroTempErrors& errors) const;
+    double relErrorD1(double error) const;
+    double relErrorMu(double error) const;
+    double relErrorF0(double error) const;
+    // Minimum of epsilonBar over the grid points.
+    double gridEpsilonMin() const;
+    // The gap only keeps kx <-> ky symmetry for alpha = +/-1.
+    int termSymmetry() const;
     // Set the variable to the value which minimizes the error in the
     // associated self-consistent equation. Return value found.
     // Note: d1 and mu equations are coupled, so they must be iterated 
@@ -69,15 +95,26 @@ protected:
     bool fixD1();
     bool fixMu();
     bool fixF0();
+    // Solve for d1, mu and f0 together as one coupled system.  If that
+    // doesn't converge, restore the old values and return false.
+    bool fixCoupled();
+    // Solve at the current gridLen, coupled or nested per env.solverMode.
+    bool solve();
+    // The three S-C sums on stBase's current grid.
+    static void gridTerms(const BaseState& stBase, double *rhs);
     // Functions to be passed into RootFinder
     static double helperD1(double x, void *params);
     static double helperMu(double x, void *params);
     static double helperF0(double x, void *params);
+    static int helperCoupled(const gsl_vector *x, void *params, 
+                             gsl_vector *f);
 };
 
 // these are #included down here because they refer to State; should have it
 // declared before including them
 #include "ZeroTempSpectrum.hh"
 #include "BZone.hh" 
+#include "AdaptiveBZone.hh"
+#include "TriangleBZone.hh"
 
 #endif
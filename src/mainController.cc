@@ -22,18 +22,35 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
+
+#include <gsl/gsl_errno.h>
 
 #include "Controller.hh"
 
 int main(int argc, char *argv[]) {
     if (argc < 3) {
-        std::cout << "usage: mainController.out path cfgFileName" << std::endl;
+        std::cout << "usage: mainController.out path cfgFileName "
+                  << "[cfgFileName ...]" << std::endl;
         return 1;
     }
-    const std::string& path = argv[1], cfgFileName = argv[2];
-    Controller& myControl = Controller::makeController(path, cfgFileName);
-    myControl.selfConsistentCalc();
-    myControl.logConfig();
-    myControl.logState();
+    // GSL's default handler aborts on failures we'd rather report.  It's
+    // global, so switch it off here once instead of around each call.
+    gsl_set_error_handler_off();
+    const std::string& path = argv[1];
+    // With more than one config, solve them all together as a sweep.
+    std::vector<Controller*> controls;
+    for (int i = 2; i < argc; i++) {
+        controls.push_back(&Controller::makeController(path, argv[i]));
+    }
+    if (controls.size() == 1) {
+        controls[0]->selfConsistentCalc();
+    } else {
+        Controller::sweepCalc(controls);
+    }
+    for (size_t i = 0; i < controls.size(); i++) {
+        controls[i]->logConfig();
+        controls[i]->logState();
+    }
     return 0;
 }
@@ -0,0 +1,94 @@
+/*
+  Copyright (c) 2011 Timothy Lovorn
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <iostream>
+#include <cmath>
+#include <cassert>
+
+#include "ConfigData.hh"
+#include "ZeroTempEnvironment.hh"
+#include "ZeroTempState.hh"
+#include "AdaptiveBZone.hh"
+
+// smooth: averages are 1/2 and 1/4
+void test_smooth(const ZeroTempState& st, const KPoint& k, double *terms) {
+    terms[0] = k.sinX * k.sinX;
+    terms[1] = k.sinX * k.sinX * k.sinY * k.sinY;
+}
+
+// sharp edge: a Fermi function filling the unit edge at beta = 200 
+// averages to 1 / (4 pi), up to terms of order exp(-200)
+void test_edge(const ZeroTempState& st, const KPoint& k, double *terms) {
+    terms[0] = 1.0 / (exp(200.0 * (k.kx * k.kx + k.ky * k.ky - 1.0)) + 1.0);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cout << "usage: test_AdaptiveBZone.out path" << std::endl;
+    }
+    std::cout << "Starting AdaptiveBZone test." << std::endl;
+    const std::string& cfgFileName = "test_cfg",
+                       path = argv[1];
+    ConfigData *cfg = new ConfigData(path, cfgFileName);
+    ZeroTempEnvironment *env = new ZeroTempEnvironment(*cfg);
+    ZeroTempState st(*env);
+
+    double smooth[2], smoothErrors[2];
+    AdaptiveResult result = AdaptiveBZone::averages<ZeroTempState>(st, st, 
+        test_smooth, 2, smooth, smoothErrors);
+    assert(result.converged);
+    assert(fabs(smooth[0] - 0.5) < env->adaptiveTol);
+    assert(fabs(smooth[1] - 0.25) < env->adaptiveTol);
+    std::cout << "smooth = " << smooth[0] << ", " << smooth[1] 
+              << " error = " << result.error << " evaluations = " 
+              << result.evaluations << std::endl;
+
+    // folding onto a quarter of the zone gives the same averages
+    double folded[2];
+    AdaptiveBZone::averages<ZeroTempState>(st, st, test_smooth, 2, folded, 
+                                           NULL, KGRID_SYM_SIN);
+    assert(fabs(folded[0] - 0.5) < env->adaptiveTol);
+    assert(fabs(folded[1] - 0.25) < env->adaptiveTol);
+
+    // the edge can't be resolved to adaptiveTol, so the cap stops it, and
+    // the error estimate should still cover the true error
+    double edge;
+    result = AdaptiveBZone::averages<ZeroTempState>(st, st, test_edge, 1, 
+                                                    &edge);
+    const double exact = 1.0 / (4.0 * M_PI);
+    assert(result.evaluations <= env->adaptiveMaxEvals);
+    assert(fabs(edge - exact) <= result.error);
+    std::cout << "edge = " << edge << " exact = " << exact << " error = " 
+              << result.error << " evaluations = " << result.evaluations
+              << " converged = " << result.converged << std::endl;
+
+    // results must come out the same no matter how many threads are used
+    cfg->setValue("numThreads", 4);
+    ZeroTempEnvironment *env_threaded = new ZeroTempEnvironment(*cfg);
+    ZeroTempState st_threaded(*env_threaded);
+    double edge_threaded;
+    AdaptiveBZone::averages<ZeroTempState>(st_threaded, st_threaded, 
+                                           test_edge, 1, &edge_threaded);
+    assert(edge_threaded == edge);
+
+    return 0;
+}
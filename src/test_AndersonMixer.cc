@@ -0,0 +1,59 @@
+/*
+  Copyright (c) 2011 Timothy Lovorn
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+#include "AndersonMixer.hh"
+
+// Slowly contracting linear map with fixed point (1, 2, 3).
+std::vector<double> test_step(const std::vector<double>& x) {
+    std::vector<double> g(3);
+    g[0] = 1.0 + 0.9 * (x[0] - 1.0) + 0.05 * (x[1] - 2.0);
+    g[1] = 2.0 + 0.8 * (x[1] - 2.0) - 0.05 * (x[2] - 3.0);
+    g[2] = 3.0 + 0.95 * (x[2] - 3.0);
+    return g;
+}
+
+int main(int argc, char *argv[]) {
+    // Aim for a tolerance of 1e-10 on each component.
+    std::vector<double> weights(3, 1e10);
+    AndersonMixer mixer(3, 3, weights);
+    std::vector<double> x(3, 0.0);
+    double err = 1.0;
+    while (err > 1e-10 && mixer.getSteps() < 100) {
+        x = mixer.mix(x, test_step(x));
+        err = fabs(x[0] - 1.0) + fabs(x[1] - 2.0) + fabs(x[2] - 3.0);
+    }
+    std::cout << "anderson steps = " << mixer.getSteps() 
+              << ", estimated plain steps = " << mixer.estimatePlainSteps()
+              << std::endl;
+    std::cout << x[0] << " " << x[1] << " " << x[2] << std::endl;
+    assert(err <= 1e-10);
+    assert(mixer.getSteps() < mixer.estimatePlainSteps());
+    // Aitken is exact for geometric sequences.
+    double aitken = AndersonMixer::aitken(1.0, 0.5, 0.25);
+    std::cout << "aitken = " << aitken << std::endl;
+    assert(fabs(aitken) < 1e-15);
+    return 0;
+}
@@ -23,10 +23,15 @@
 #include <iostream>
 #include <cmath>
 #include <cassert>
+#include <vector>
 
 #include "ConfigData.hh"
 #include "ZeroTempEnvironment.hh"
 #include "ZeroTempState.hh"
+#include "PairTempEnvironment.hh"
+#include "PairTempState.hh"
+#include "CritTempEnvironment.hh"
+#include "CritTempState.hh"
 #include "BZone.hh"
 
 double test_1(const ZeroTempState& st, double kx, double ky) {
@@ -46,6 +51,19 @@ double test_step(const ZeroTempState& st, double kx, double ky) {
     } 
 }
 
+void test_multi(const ZeroTempState& st, const KPoint& k, double *terms) {
+    terms[0] = 1.0;
+    terms[1] = k.sinX + k.sinY;
+}
+
+// functor version of test_sin, which traverse can inline
+class TestSinFunc {
+public:
+    double operator()(const KPoint& k) const {
+        return k.sinX + k.sinY;
+    }
+};
+
 int main(int argc, char *argv[]) {
     if (argc < 2) {
         std::cout << "usage: test_BZone.out path" << std::endl;
@@ -67,9 +85,175 @@ int main(int argc, char *argv[]) {
     assert(avg_sin < sin_tol);
     std::cout << "avg_sin = " << avg_sin << std::endl;
 
+    double avg_multi[2];
+    BZone::averages<ZeroTempState>(st, st, test_multi, 2, avg_multi);
+    assert(avg_multi[0] == avg_1 && avg_multi[1] == avg_sin);
+    std::cout << "avg_multi = " << avg_multi[0] << ", " << avg_multi[1] 
+              << std::endl;
+
     double min_step = BZone::minimum<ZeroTempState>(st, st, test_step);
     assert(min_step == -1);
     std::cout << "min_step = " << min_step << std::endl;
 
+    // generic traversal with a functor and other accumulators
+    const int N = env->gridLen;
+    double avg_functor = BZone::traverse(st, TestSinFunc(), 
+                                         BZoneSum()).sum / (N * N);
+    assert(avg_functor == avg_sin);
+    double max_step = BZone::traverse(st, 
+        BZoneKxKyFunc<ZeroTempState>(st, test_step), BZoneMax()).max;
+    assert(max_step == 1);
+    std::cout << "avg_functor = " << avg_functor << ", max_step = " 
+              << max_step << std::endl;
+
+    // vectorized kernels must agree with the scalar reference
+    double scalar[3], batch[3];
+    BZone::averages<ZeroTempState>(st, st, ZeroTempSpectrum::innerAll, 3, 
+                                   scalar);
+    BZone::averagesBatch<ZeroTempState>(st, st, 
+        ZeroTempSpectrum::innerAllBatch, 3, batch);
+    for (int i = 0; i < 3; i++) {
+        assert(fabs(batch[i] - scalar[i]) <= 1e-12 * fabs(scalar[i]));
+    }
+    std::cout << "batch = " << batch[0] << ", " << batch[1] << ", " 
+              << batch[2] << std::endl;
+
+    // single-precision kernels stay close to double
+    double batch_float[3];
+    BZone::averagesBatch<ZeroTempState>(st, st, 
+        ZeroTempSpectrum::innerAllBatchFloat, 3, batch_float);
+    for (int i = 0; i < 3; i++) {
+        assert(fabs(batch_float[i] - batch[i]) <= 1e-5 * fabs(batch[i]));
+    }
+    std::cout << "batch_float = " << batch_float[0] << ", " 
+              << batch_float[1] << ", " << batch_float[2] << std::endl;
+
+    // symmetry-reduced grid: same sums from fewer points
+    const KGrid& reduced = KGrid::forGridLen(N, KGRID_SYM_ALL);
+    double weightSum = 0.0;
+    for (int k = 0; k < reduced.numPoints; k++) {
+        weightSum += reduced.weight[k];
+    }
+    assert(weightSum == N * N);
+    double batch_reduced[3], scalar_reduced[3];
+    BZone::averagesBatch<ZeroTempState>(st, st, 
+        ZeroTempSpectrum::innerAllBatch, 3, batch_reduced, KGRID_SYM_ALL);
+    BZone::averages<ZeroTempState>(st, st, ZeroTempSpectrum::innerAll, 3, 
+                                   scalar_reduced, KGRID_SYM_ALL);
+    for (int i = 0; i < 3; i++) {
+        assert(fabs(batch_reduced[i] - batch[i]) <= 1e-12 * fabs(batch[i]));
+        assert(fabs(scalar_reduced[i] - batch[i]) <= 1e-12 * fabs(batch[i]));
+    }
+    std::cout << "reduced grid points = " << reduced.numPoints << " of " 
+              << N * N << std::endl;
+
+    // so must the pair and critical temperature kernels
+    ConfigData *cfgPair = new ConfigData(path, "test_pair_cfg");
+    PairTempEnvironment *envPair = new PairTempEnvironment(*cfgPair);
+    PairTempState stPair(*envPair);
+    double scalarPair[3], batchPair[3];
+    BZone::averages<PairTempState>(stPair, stPair, 
+        PairTempSpectrum::innerAll, 3, scalarPair);
+    BZone::averagesBatch<PairTempState>(stPair, stPair, 
+        PairTempSpectrum::innerAllBatch, 3, batchPair);
+    for (int i = 0; i < 3; i++) {
+        assert(fabs(batchPair[i] - scalarPair[i]) 
+               <= 1e-12 * fabs(scalarPair[i]));
+    }
+    std::cout << "pair batch = " << batchPair[0] << ", " << batchPair[1] 
+              << ", " << batchPair[2] << std::endl;
+    ConfigData *cfgCrit = new ConfigData(path, "test_crit_cfg");
+    CritTempEnvironment *envCrit = new CritTempEnvironment(*cfgCrit);
+    CritTempState stCrit(*envCrit);
+    double scalarCrit[3], batchCrit[3];
+    BZone::averages<CritTempState>(stCrit, stCrit, 
+        CritTempSpectrum::innerAll, 3, scalarCrit);
+    BZone::averagesBatch<CritTempState>(stCrit, stCrit, 
+        CritTempSpectrum::innerAllBatch, 3, batchCrit);
+    for (int i = 0; i < 3; i++) {
+        assert(fabs(batchCrit[i] - scalarCrit[i]) 
+               <= 1e-12 * fabs(scalarCrit[i]));
+    }
+    std::cout << "crit batch = " << batchCrit[0] << ", " << batchCrit[1] 
+              << ", " << batchCrit[2] << std::endl;
+
+    // the closed-form epsilonMin is the grid minimum of epsilonBar (gridLen
+    // is a multiple of 4) with each of 0, A and B the smallest of the three
+    const double d1s[3] = {0.05, 0.3, 0.05}, thps[3] = {0.1, 0.1, 2.5};
+    for (int i = 0; i < 3; i++) {
+        cfg->setValue("initD1", d1s[i]);
+        cfg->setValue("thp", thps[i]);
+        ZeroTempEnvironment *envMin = new ZeroTempEnvironment(*cfg);
+        ZeroTempState stMin(*envMin);
+        const double gridMin = BZone::minimum<ZeroTempState>(stMin, stMin, 
+            ZeroTempSpectrum::epsilonBar);
+        std::cout << "epsilonMin = " << stMin.getEpsilonMin() 
+                  << ", grid minimum = " << gridMin << std::endl;
+        assert(fabs(stMin.getEpsilonMin() - gridMin) < 1e-12);
+    }
+    cfg->setValue("initD1", env->initD1);
+    cfg->setValue("thp", env->thp);
+
+    // sums must come out the same no matter how many threads are used
+    cfg->setValue("numThreads", 4);
+    ZeroTempEnvironment *env_threaded = new ZeroTempEnvironment(*cfg);
+    ZeroTempState st_threaded(*env_threaded);
+    double avg_sin_threaded = BZone::average<ZeroTempState>(st_threaded, 
+        st_threaded, test_sin);
+    assert(avg_sin_threaded == avg_sin);
+    std::cout << "avg_sin_threaded = " << avg_sin_threaded << std::endl;
+    double min_eps = BZone::minimum<ZeroTempState>(st, st, 
+        ZeroTempSpectrum::epsilonBar);
+    double min_eps_threaded = BZone::minimum<ZeroTempState>(st_threaded, 
+        st_threaded, ZeroTempSpectrum::epsilonBar);
+    assert(min_eps_threaded == min_eps);
+    double batch_threaded[3], reduced_threaded[3];
+    BZone::averagesBatch<ZeroTempState>(st_threaded, st_threaded, 
+        ZeroTempSpectrum::innerAllBatch, 3, batch_threaded);
+    BZone::averagesBatch<ZeroTempState>(st_threaded, st_threaded, 
+        ZeroTempSpectrum::innerAllBatch, 3, reduced_threaded, 
+        KGRID_SYM_ALL);
+    for (int i = 0; i < 3; i++) {
+        assert(batch_threaded[i] == batch[i]);
+        assert(reduced_threaded[i] == batch_reduced[i]);
+    }
+    cfgPair->setValue("numThreads", 4);
+    PairTempEnvironment *envPairThreaded = new PairTempEnvironment(*cfgPair);
+    PairTempState stPairThreaded(*envPairThreaded);
+    double pairThreaded[3];
+    BZone::averagesBatch<PairTempState>(stPairThreaded, stPairThreaded, 
+        PairTempSpectrum::innerAllBatch, 3, pairThreaded);
+    cfgCrit->setValue("numThreads", 4);
+    CritTempEnvironment *envCritThreaded = new CritTempEnvironment(*cfgCrit);
+    CritTempState stCritThreaded(*envCritThreaded);
+    double critThreaded[3];
+    BZone::averagesBatch<CritTempState>(stCritThreaded, stCritThreaded, 
+        CritTempSpectrum::innerAllBatch, 3, critThreaded);
+    for (int i = 0; i < 3; i++) {
+        assert(pairThreaded[i] == batchPair[i]);
+        assert(critThreaded[i] == batchCrit[i]);
+    }
+    // batched States, on 1 and 4 threads
+    cfg->setValue("x", 2.0 * env->x);
+    ZeroTempEnvironment *env_doped = new ZeroTempEnvironment(*cfg);
+    ZeroTempState st_doped(*env_doped);
+    std::vector<const ZeroTempState*> states, states_threaded;
+    states.push_back(&st);
+    states.push_back(&st_doped);
+    states_threaded.push_back(&st_threaded);
+    states_threaded.push_back(&st_doped);
+    double multi[6], multi_threaded[6];
+    BZone::averagesBatchMulti<ZeroTempState>(states, 
+        ZeroTempSpectrum::innerAllBatch, 3, multi, KGRID_SYM_ALL);
+    BZone::averagesBatchMulti<ZeroTempState>(states_threaded, 
+        ZeroTempSpectrum::innerAllBatch, 3, multi_threaded, KGRID_SYM_ALL);
+    for (int i = 0; i < 6; i++) {
+        assert(multi_threaded[i] == multi[i]);
+    }
+    std::cout << "threaded min_eps = " << min_eps_threaded 
+              << ", batch = " << batch_threaded[0] << ", pair batch = " 
+              << pairThreaded[0] << ", crit batch = " << critThreaded[0]
+              << std::endl;
+
     return 0;
 }
@@ -23,12 +23,16 @@
 #include <cassert>
 #include <iostream>
 
+#include <gsl/gsl_errno.h>
+
 #include "Controller.hh"
 
 int main(int argc, char *argv[]) {
     if (argc < 2) {
         std::cout << "usage: test_Controller.out path" << std::endl;
     }
+    // as mainController does
+    gsl_set_error_handler_off();
     const std::string& cfgFileName = "test_cfg",
                        path = argv[1];
     Controller& myControl = Controller::makeController(path, cfgFileName);
@@ -0,0 +1,223 @@
+/*
+  Copyright (c) 2011 Timothy Lovorn
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <iostream>
+#include <cmath>
+#include <cassert>
+
+#include <gsl/gsl_errno.h>
+
+#include "ConfigData.hh"
+#include "CritTempEnvironment.hh"
+#include "CritTempState.hh"
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cout << "usage: test_CritTempSpectrum.out path" << std::endl;
+    }
+    // as mainController does
+    gsl_set_error_handler_off();
+    std::cout << "Starting CritTempSpectrum test." << std::endl;
+    const std::string& cfgFileName = "test_crit_cfg",
+                       path = argv[1];
+    ConfigData *cfg = new ConfigData(path, cfgFileName);
+    CritTempEnvironment *env = new CritTempEnvironment(*cfg);
+    CritTempState st(*env);
+
+    // the batch Pi (shifted sines by angle addition, half the grid) matches
+    // its components summed one at a time by the scalar functions
+    const double omega = -0.5, kx = 0.1, ky = 0.05;
+    const PiOutput pi = CritTempSpectrum::getPi(st, omega, kx, ky);
+    InnerPiInput ipi(st, omega, kx, ky);
+    const double xx = BZone::average<InnerPiInput>(st, ipi, 
+                          CritTempSpectrum::innerPiXX),
+                 xy = BZone::average<InnerPiInput>(st, ipi, 
+                          CritTempSpectrum::innerPiXY),
+                 yy = BZone::average<InnerPiInput>(st, ipi, 
+                          CritTempSpectrum::innerPiYY);
+    std::cout << "Pi = " << pi.xx << ", " << pi.xy << ", " << pi.yy 
+              << std::endl;
+    assert(fabs(pi.xx - xx) < 1e-12 * fabs(xx));
+    assert(fabs(pi.xy - xy) < 1e-12 * fabs(xy));
+    assert(fabs(pi.yy - yy) < 1e-12 * fabs(yy));
+
+    // Pi at several omegas in one pass matches Pi at each alone (summed in
+    // blocks, so only to rounding)
+    std::vector<double> omegas(2, omega);
+    omegas[1] = 0.1;
+    double nodes[6];
+    CritTempSpectrum::getPiNodes(st, omegas, kx, ky, nodes);
+    const PiOutput pi1 = CritTempSpectrum::getPi(st, omegas[1], kx, ky);
+    const double alone[6] = {pi.xx, pi.xy, pi.yy, pi1.xx, pi1.xy, pi1.yy};
+    for (int i = 0; i < 6; i++) {
+        assert(fabs(nodes[i] - alone[i]) < 1e-12 * fabs(alone[i]));
+    }
+
+    // with a larger tz, Lambda has a root below the pair continuum, where
+    // the Pi table interpolates well
+    cfg->setValue("tz", 1.9);
+    cfg->setValue("omegaRootMode", std::string("table"));
+    CritTempEnvironment *envTable = new CritTempEnvironment(*cfg);
+    CritTempState stTable(*envTable);
+    LambdaInput lin(stTable, kx, ky, 0.0, true);
+    const PiTable table(lin, -2.0 * OMEGA_TABLE_FRACTION * stTable.getMu());
+    const PiOutput tablePi = CritTempSpectrum::tablePi(table, 0.1234);
+    const PiOutput exactPi = CritTempSpectrum::getPi(stTable, 0.1234, kx, ky);
+    std::cout << "table Pi error = " << tablePi.xx - exactPi.xx << ", " 
+              << tablePi.xy - exactPi.xy << ", " << tablePi.yy - exactPi.yy
+              << std::endl;
+    assert(fabs(tablePi.xx - exactPi.xx) < 1e-10);
+    assert(fabs(tablePi.xy - exactPi.xy) < 1e-10);
+    assert(fabs(tablePi.yy - exactPi.yy) < 1e-10);
+    // the exact Lambda changes sign across the root found on the table
+    const double omegaTable = CritTempSpectrum::omegaExact(stTable, kx, ky,
+                                                           0.0);
+    std::cout << "omega = " << omegaTable << std::endl;
+    assert(omegaTable > 0.0);
+    assert(CritTempSpectrum::getLambda(omegaTable - OMEGA_ROOT_TOL, &lin) 
+           * CritTempSpectrum::getLambda(omegaTable + OMEGA_ROOT_TOL, &lin)
+           <= 0.0);
+
+    // dLambda/domega from the same pass matches a finite difference, and 
+    // Newton's method finds the same root
+    double dLambda;
+    const double lambdaAt = CritTempSpectrum::getLambdaDeriv(lin, 0.1, 
+                                                             &dLambda);
+    const double fdLambda = (CritTempSpectrum::getLambda(0.1 + 1e-5, &lin)
+                             - CritTempSpectrum::getLambda(0.1 - 1e-5, &lin))
+                            / 2e-5;
+    std::cout << "dLambda = " << dLambda << ", difference " << fdLambda 
+              << std::endl;
+    assert(fabs(lambdaAt - CritTempSpectrum::getLambda(0.1, &lin)) < 1e-12);
+    assert(fabs(dLambda - fdLambda) < 1e-6 * fabs(dLambda));
+    const double omegaNewton = CritTempSpectrum::omegaNewton(stTable, kx, 
+                                                             ky, 0.0);
+    std::cout << "Newton omega = " << omegaNewton << std::endl;
+    assert(fabs(omegaNewton - omegaTable) < 2.0 * OMEGA_ROOT_TOL);
+
+    // Pi at every k with q + k/2 on the grid, from FFTs, matches the direct
+    // sums
+    const int M = stTable.getGridLen() / 2;
+    std::vector<double> piGrid;
+    bool gotGrid = CritTempSpectrum::getPiGrid(stTable, 0.1, piGrid);
+    assert(gotGrid);
+    assert((int)piGrid.size() == 3 * M * M);
+    const int ms[5][2] = {{0, 0}, {1, 0}, {1, 2}, {M - 1, 3}, {3, 1}};
+    for (int i = 0; i < 5; i++) {
+        const int mx = ms[i][0], my = ms[i][1], m = my * M + mx;
+        const PiOutput direct = CritTempSpectrum::getPi(stTable, 0.1, 
+                                    2.0 * M_PI * mx / M,
+                                    2.0 * M_PI * my / M);
+        std::cout << "Pi grid (" << mx << ", " << my << ") error = " 
+                  << piGrid[3 * m] - direct.xx << ", " 
+                  << piGrid[3 * m + 1] - direct.xy << ", " 
+                  << piGrid[3 * m + 2] - direct.yy << std::endl;
+        assert(fabs(piGrid[3 * m] - direct.xx) < 1e-11);
+        assert(fabs(piGrid[3 * m + 1] - direct.xy) < 1e-11);
+        assert(fabs(piGrid[3 * m + 2] - direct.yy) < 1e-11);
+    }
+    // no poles allowed
+    gotGrid = CritTempSpectrum::getPiGrid(stTable, -4.0 * stTable.getMu(),
+                                          piGrid);
+    assert(!gotGrid);
+
+    // getNu's tasks, with the threads split between their nested passes,
+    // give the same result on any number of threads
+    const double nuSerial = CritTempSpectrum::getNu(stTable);
+    cfg->setValue("numThreads", 4);
+    CritTempEnvironment *envTasks = new CritTempEnvironment(*cfg);
+    CritTempState stTasks(*envTasks);
+    const double nuTasks = CritTempSpectrum::getNu(stTasks);
+    std::cout << "nu = " << nuSerial << ", with tasks " << nuTasks 
+              << std::endl;
+    assert(nuSerial == nuTasks);
+
+    // the state's nu is reused until the variables move
+    const double nuFirst = stTable.getNu(), nuAgain = stTable.getNu();
+    assert(nuFirst == nuSerial);
+    assert(nuAgain == nuSerial);
+    const OmegaCoeffs ocsCached = stTable.getOmegaCoeffs(),
+                      ocsFresh = CritTempSpectrum::getOmegaCoeffs(stTable);
+    assert(ocsCached.planar == ocsFresh.planar);
+    double vars[3];
+    stTable.getVariables(vars);
+    vars[2] *= 1.01;
+    stTable.setVariables(vars);
+    const double nuMoved = stTable.getNu();
+    assert(nuMoved != nuSerial);
+    const NuCache& cache = stTable.getNuCache();
+    std::cout << "nu cache hits = " << cache.hits << ", misses = " 
+              << cache.misses << std::endl;
+    assert(cache.hits == 2 && cache.misses == 2);
+    vars[2] /= 1.01;
+    stTable.setVariables(vars);
+
+    // the Bose integral's two expansions match quadrature and each other 
+    // where they meet
+    const double as[6] = {0.01, 0.5, 2.0, 3.0, 10.0, 40.0},
+                 quad[6] = {0.1996669999996913, 1.302241404450357, 
+                            2.0676240309852187, 2.213854132233602, 
+                            2.315006939738694, 2.315157373394117};
+    for (int i = 0; i < 6; i++) {
+        const double bose = CritTempSpectrum::boseIntegral(as[i]);
+        std::cout << "bose integral(" << as[i] << ") error = " 
+                  << bose - quad[i] << std::endl;
+        assert(fabs(bose - quad[i]) < 1e-13);
+    }
+    assert(fabs(CritTempSpectrum::boseIntegral(BOSE_SERIES_MAX) 
+                - CritTempSpectrum::boseIntegral(BOSE_SERIES_MAX + 1e-12))
+           < 1e-12);
+
+    // the expanded omega coefficients match finite differences of Lambda
+    double lambda0, dOmega;
+    const OmegaCoeffs ocs = CritTempSpectrum::expandOmegaCoeffs(stTable, 
+                                &lambda0, &dOmega);
+    const double h = 1e-2;
+    LambdaInput lin0(stTable, 0.0, 0.0, 0.0, true),
+                linX(stTable, h, 0.0, 0.0, true),
+                linXY(stTable, h, h, 0.0, true),
+                linZ(stTable, 0.0, 0.0, h, true);
+    const double lambdaZero = CritTempSpectrum::getLambda(0.0, &lin0),
+                 fdOmega = (CritTempSpectrum::getLambda(h, &lin0) 
+                            - CritTempSpectrum::getLambda(-h, &lin0)) 
+                           / (2.0 * h),
+                 fdPlanar = -(CritTempSpectrum::getLambda(0.0, &linX) 
+                              - lambdaZero) / (h * h * dOmega),
+                 fdCross = -(CritTempSpectrum::getLambda(0.0, &linXY) 
+                             - lambdaZero) / (h * h * dOmega) 
+                           - 2.0 * fdPlanar,
+                 fdPerp = -(CritTempSpectrum::getLambda(0.0, &linZ) 
+                            - lambdaZero) / (h * h * dOmega);
+    std::cout << "expanded: lambda0 = " << lambda0 << " dOmega = " << dOmega
+              << " planar = " << ocs.planar << " perp = " << ocs.perp 
+              << " cross = " << ocs.cross << std::endl;
+    std::cout << "differences: lambda0 = " << lambdaZero << " dOmega = " 
+              << fdOmega << " planar = " << fdPlanar << " perp = " << fdPerp
+              << " cross = " << fdCross << std::endl;
+    assert(fabs(lambda0 - lambdaZero) < 1e-12);
+    assert(fabs(dOmega - fdOmega) < 1e-3 * fabs(dOmega));
+    assert(fabs(ocs.planar - fdPlanar) < 1e-2 * fabs(ocs.planar));
+    assert(fabs(ocs.perp - fdPerp) < 1e-2 * fabs(ocs.perp));
+    assert(fabs(ocs.cross - fdCross) < 1e-2 * fabs(ocs.planar));
+
+    return 0;
+}
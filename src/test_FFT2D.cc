@@ -0,0 +1,74 @@
+/*
+  Copyright (c) 2011 Timothy Lovorn
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <iostream>
+#include <cmath>
+#include <cassert>
+#include <vector>
+
+#include "FFT2D.hh"
+
+int main(int argc, char *argv[]) {
+    std::cout << "Starting FFT2D test." << std::endl;
+    // 6 isn't a power of 2
+    const int n = 6;
+    std::vector<double> data(2 * n * n), orig;
+    for (int k = 0; k < n * n; k++) {
+        data[2 * k] = sin(1.3 * k);
+        data[2 * k + 1] = cos(0.7 * k * k);
+    }
+    orig = data;
+    FFT2D fft(n);
+    fft.forward(&data[0]);
+    // compare with the transform summed directly
+    double maxError = 0.0;
+    for (int my = 0; my < n; my++) {
+        for (int mx = 0; mx < n; mx++) {
+            double re = 0.0, im = 0.0;
+            for (int iy = 0; iy < n; iy++) {
+                for (int ix = 0; ix < n; ix++) {
+                    const int k = iy * n + ix;
+                    const double phase = -2.0 * M_PI * (mx * ix + my * iy) 
+                                         / n;
+                    re += orig[2 * k] * cos(phase) 
+                          - orig[2 * k + 1] * sin(phase);
+                    im += orig[2 * k] * sin(phase) 
+                          + orig[2 * k + 1] * cos(phase);
+                }
+            }
+            const int m = my * n + mx;
+            maxError = std::max(maxError, fabs(data[2 * m] - re));
+            maxError = std::max(maxError, fabs(data[2 * m + 1] - im));
+        }
+    }
+    std::cout << "forward error = " << maxError << std::endl;
+    assert(maxError < 1e-12);
+    // backward undoes forward up to n^2
+    fft.backward(&data[0]);
+    maxError = 0.0;
+    for (int i = 0; i < 2 * n * n; i++) {
+        maxError = std::max(maxError, fabs(data[i] / (n * n) - orig[i]));
+    }
+    std::cout << "round trip error = " << maxError << std::endl;
+    assert(maxError < 1e-13);
+    return 0;
+}
@@ -21,6 +21,9 @@
 */
 
 #include <iostream>
+#include <cmath>
+#include <cassert>
+#include <vector>
 
 #include "Logger.hh"
 #include "Integrator.hh"
@@ -30,14 +33,72 @@ double test_integrator_linear(double x, void *params) {
     return x;
 }
 
+// integral from 0 to 1 is 2
+double test_integrator_singular(double x, void *params) {
+    return 1.0 / sqrt(x);
+}
+
+// params points to the power
+double test_integrator_power(double x, void *params) {
+    return pow(x, *(double*)params);
+}
+
 int main(int argc, char *argv[]) {
     if (argc < 2) {
         std::cout << "usage: test_Controller.out path" << std::endl;
     }
+    // as mainController does
+    gsl_set_error_handler_off();
     const std::string& path = argv[1];
     Logger error(path, "test_error_log");
     Integrator integrator(&test_integrator_linear, NULL, 1e-6, 1e-6);
     double integral = integrator.doIntegral(0, 1.0, error);
     std::cout << integral << std::endl;
+    assert(fabs(integral - 0.5) < 1e-6);
+
+    // results come with their error estimates and evaluation counts
+    Integrator singular(&test_integrator_singular, NULL, 1e-8, 1e-8);
+    const IntegralResult result = singular.integrate(0.0, 1.0);
+    std::cout << "singular = " << result.value << " +/- " << result.error 
+              << " in " << result.evaluations << " evaluations" 
+              << std::endl;
+    assert(result.converged && fabs(result.value - 2.0) < 1e-6);
+    assert(result.evaluations > 0);
+    const IntegralResult smooth = integrator.integrateSmooth(0.0, 1.0);
+    assert(smooth.converged && fabs(smooth.value - 0.5) < 1e-10);
+    assert(smooth.evaluations > 0);
+
+    // Integrators made one after another share one workspace (two are 
+    // still held above)
+    const int allocated = Integrator::workspacesAllocated();
+    for (int i = 0; i < 10; i++) {
+        Integrator again(&test_integrator_linear, NULL, 1e-6, 1e-6);
+        again.integrate(0.0, 1.0);
+    }
+    assert(Integrator::workspacesAllocated() == allocated + 1);
+
+    // a batch of integrals matches the same integrals done one at a time
+    const double powers[4] = {0.5, 1.0, 2.0, 3.0};
+    std::vector<IntegralSpec> specs;
+    for (int i = 0; i < 4; i++) {
+        specs.push_back(IntegralSpec(&test_integrator_power, 
+                                     (void*)&powers[i], 0.0, 2.0));
+    }
+    std::vector<IntegralResult> results;
+    Integrator::integrateBatch(specs, 1e-10, 1e-10, false, 2, results);
+    for (int i = 0; i < 4; i++) {
+        Integrator one(&test_integrator_power, (void*)&powers[i], 1e-10, 
+                       1e-10);
+        const double exact = pow(2.0, powers[i] + 1.0) / (powers[i] + 1.0);
+        std::cout << "x^" << powers[i] << ": " << results[i].value 
+                  << std::endl;
+        assert(results[i].value == one.integrate(0.0, 2.0).value);
+        assert(fabs(results[i].value - exact) < 1e-8);
+    }
+    Integrator::integrateBatch(specs, 1e-10, 1e-10, true, 2, results);
+    for (int i = 1; i < 4; i++) {
+        assert(fabs(results[i].value - pow(2.0, powers[i] + 1.0) 
+                                       / (powers[i] + 1.0)) < 1e-8);
+    }
     return 0;
 }
@@ -0,0 +1,49 @@
+/*
+  Copyright (c) 2011 Timothy Lovorn
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <cassert>
+
+#include "MultiRootFinder.hh"
+
+// should converge to (x, y) = (2, 1)
+int test_root_linear(const gsl_vector *x, void *params, gsl_vector *f) {
+    const double x0 = gsl_vector_get(x, 0), x1 = gsl_vector_get(x, 1);
+    gsl_vector_set(f, 0, x0 + x1 - 3);
+    gsl_vector_set(f, 1, x0 - x1 - 1);
+    return GSL_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+    // as mainController does
+    gsl_set_error_handler_off();
+    std::vector<double> guess(2, 0.0);
+    MultiRootFinder mrf(&test_root_linear, NULL, guess, 1e-6);
+    const MultiRootData& rd = mrf.findRoot();
+    std::cout << rd.converged << std::endl << rd.root[0] << " " << rd.root[1]
+        << std::endl << rd.fnvalue[0] << " " << rd.fnvalue[1] << std::endl;
+    assert(rd.converged);
+    assert(fabs(rd.root[0] - 2.0) < 1e-6 && fabs(rd.root[1] - 1.0) < 1e-6);
+    return 0;
+}
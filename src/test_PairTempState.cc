@@ -0,0 +1,100 @@
+/*
+  Copyright (c) 2011 Timothy Lovorn
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <iostream>
+#include <cmath>
+#include <cassert>
+
+#include <gsl/gsl_errno.h>
+
+#include "ConfigData.hh"
+#include "PairTempEnvironment.hh"
+#include "PairTempState.hh"
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cout << "usage: test_PairTempState.out path" << std::endl;
+    }
+    // as mainController does
+    gsl_set_error_handler_off();
+    std::cout << "Starting PairTempState test." << std::endl;
+    const std::string& cfgFileName = "test_pair_cfg",
+                       path = argv[1];
+    ConfigData *cfg = new ConfigData(path, cfgFileName);
+    PairTempEnvironment *env = new PairTempEnvironment(*cfg);
+    PairTempState st(*env);
+    double plain[3];
+    st.averageTerms(plain);
+
+    // the sums on a grid four times finer stand in for the exact ones
+    const int gridLen = cfg->getValue<int>("gridLen");
+    cfg->setValue("gridLen", 4 * gridLen);
+    PairTempEnvironment *envFine = new PairTempEnvironment(*cfg);
+    PairTempState stFine(*envFine);
+    double exact[3];
+    stFine.averageTerms(exact);
+    cfg->setValue("gridLen", gridLen);
+
+    // the sums converge exponentially, so extrapolating mustn't move them
+    // further from the exact ones than the plain gridLen sums are
+    for (int levels = 2; levels <= 3; levels++) {
+        cfg->setValue("extrapolationLevels", levels);
+        PairTempEnvironment *envExtrap = new PairTempEnvironment(*cfg);
+        PairTempState stExtrap(*envExtrap);
+        double extrap[3], discError[3];
+        stExtrap.averageTerms(extrap, discError);
+        for (int i = 0; i < 3; i++) {
+            const double plainError = fabs(plain[i] - exact[i]),
+                         extrapError = fabs(extrap[i] - exact[i]);
+            std::cout << levels << " levels, sum " << i << ": plain error "
+                      << plainError << ", extrapolated error " 
+                      << extrapError << ", estimate " << discError[i] 
+                      << std::endl;
+            assert(extrapError <= plainError + 1e-14 * fabs(exact[i]));
+            if (levels == 2) {
+                assert(discError[i] >= plainError);
+            }
+        }
+    }
+    cfg->setValue("extrapolationLevels", 1);
+
+    // a tolerance tighter than the float sums can reach must still get
+    // there in mixed precision, and agree with the double-only solve
+    cfg->setValue("tolD1", 1e-11);
+    cfg->setValue("tolMu", 1e-11);
+    cfg->setValue("tolBp", 1e-11);
+    PairTempEnvironment *envDouble = new PairTempEnvironment(*cfg);
+    PairTempState stDouble(*envDouble);
+    bool success = stDouble.makeSelfConsistent();
+    assert(success);
+    cfg->setValue("precisionMode", std::string("mixed"));
+    PairTempEnvironment *envMixed = new PairTempEnvironment(*cfg);
+    PairTempState stMixed(*envMixed);
+    success = stMixed.makeSelfConsistent();
+    assert(success);
+    std::cout << "tight tolerance: double d1 = " << stDouble.getD1() 
+              << ", mixed d1 = " << stMixed.getD1() << std::endl;
+    assert(fabs(stMixed.getD1() - stDouble.getD1()) < 1e-10);
+    assert(fabs(stMixed.getMu() - stDouble.getMu()) < 1e-10);
+    assert(fabs(stMixed.getBp() - stDouble.getBp()) < 1e-10);
+    return 0;
+}
@@ -21,6 +21,8 @@
 */
 
 #include <iostream>
+#include <cmath>
+#include <cassert>
 
 #include "RootFinder.hh"
 
@@ -29,10 +31,24 @@ double test_root_linear(double x, void *params) {
     return 1 - x;
 }
 
+// a bracket helper with no sign change anywhere in [-10, 10]
+double test_no_root(double x, void *params) {
+    return 1.0;
+}
+
 int main(int argc, char *argv[]) {
     RootFinder rf(&test_root_linear, NULL, 0.0, -10.0, 10.0, 1e-6);
     const RootData& rd = rf.findRoot();
     std::cout << rd.converged << std::endl << rd.root << std::endl
         << rd.fnvalue << std::endl;
+
+    // a bracket helper that finds nothing falls back to the real function
+    RootFinder rfHelped(&test_root_linear, NULL, 0.0, -10.0, 10.0, 1e-6);
+    rfHelped.setBracketHelper(&test_no_root, NULL);
+    const RootData& rdHelped = rfHelped.findRoot();
+    std::cout << rdHelped.converged << std::endl << rdHelped.root 
+              << std::endl;
+    assert(rdHelped.converged);
+    assert(fabs(rdHelped.root - 1.0) < 1e-6);
     return 0;
 }
@@ -0,0 +1,91 @@
+/*
+  Copyright (c) 2011 Timothy Lovorn
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <iostream>
+#include <cmath>
+#include <cassert>
+#include <vector>
+
+#include <gsl/gsl_errno.h>
+
+#include "ConfigData.hh"
+#include "ZeroTempEnvironment.hh"
+#include "ZeroTempState.hh"
+#include "SweepSolver.hh"
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cout << "usage: test_SweepSolver.out path" << std::endl;
+    }
+    // as mainController does
+    gsl_set_error_handler_off();
+    std::cout << "Starting SweepSolver test." << std::endl;
+    const std::string& cfgFileName = "test_cfg",
+                       path = argv[1];
+    ConfigData *cfg = new ConfigData(path, cfgFileName);
+    const double xs[3] = {0.05, 0.06, 0.07};
+    std::vector<BaseState*> sweep;
+    std::vector<ZeroTempState*> alone;
+    for (int i = 0; i < 3; i++) {
+        cfg->setValue("x", xs[i]);
+        ZeroTempEnvironment *env = new ZeroTempEnvironment(*cfg);
+        sweep.push_back(new ZeroTempState(*env));
+        alone.push_back(new ZeroTempState(*env));
+    }
+
+    // one batched traversal gives the same sums as a traversal per State
+    std::vector<const ZeroTempState*> batch;
+    for (int i = 0; i < 3; i++) {
+        batch.push_back(alone[i]);
+    }
+    double multi[9];
+    BZone::averagesBatchMulti<ZeroTempState>(batch, 
+        ZeroTempSpectrum::innerAllBatch, 3, multi, KGRID_SYM_ALL);
+    for (int i = 0; i < 3; i++) {
+        double single[3];
+        BZone::averagesBatch<ZeroTempState>(*alone[i], *alone[i], 
+            ZeroTempSpectrum::innerAllBatch, 3, single, KGRID_SYM_ALL);
+        for (int j = 0; j < 3; j++) {
+            assert(multi[3 * i + j] == single[j]);
+        }
+    }
+
+    SweepSolver solver(sweep);
+    bool success = solver.solve();
+    assert(success);
+    for (int i = 0; i < 3; i++) {
+        assert(sweep[i]->checkSelfConsistent());
+        success = alone[i]->makeSelfConsistent();
+        assert(success);
+        const ZeroTempState& st = *(ZeroTempState*)sweep[i];
+        std::cout << "x = " << xs[i] << ": sweep d1 = " << st.getD1() 
+                  << " mu = " << st.getMu() << " f0 = " << st.getF0() 
+                  << "; alone d1 = " << alone[i]->getD1() << " mu = " 
+                  << alone[i]->getMu() << " f0 = " << alone[i]->getF0() 
+                  << std::endl;
+        assert(fabs(st.getD1() - alone[i]->getD1()) < 1e-4);
+        assert(fabs(st.getMu() - alone[i]->getMu()) < 1e-4);
+        assert(fabs(st.getF0() - alone[i]->getF0()) < 1e-4);
+    }
+
+    return 0;
+}
@@ -0,0 +1,118 @@
+/*
+  Copyright (c) 2011 Timothy Lovorn
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <iostream>
+#include <cmath>
+#include <cassert>
+
+#include "ConfigData.hh"
+#include "ZeroTempEnvironment.hh"
+#include "ZeroTempState.hh"
+#include "TriangleBZone.hh"
+
+// h = 1: integrate gives the mean of f
+double unit(double e, double param) {
+    return 1.0;
+}
+
+void unitMoments(double a, double b, double param, double *moments) {
+    moments[0] = b - a;
+    moments[1] = (b * b - a * a) / 2.0;
+    moments[2] = (b * b * b - a * a * a) / 3.0;
+}
+
+// S-C sums with the given integrator and grid
+void terms(ConfigData *cfg, const std::string& integrator, int gridLen, 
+           int numThreads, double *out) {
+    cfg->setValue("bzoneIntegrator", integrator);
+    cfg->setValue("gridLen", gridLen);
+    cfg->setValue("numThreads", numThreads);
+    ZeroTempEnvironment env(*cfg);
+    ZeroTempState st(env);
+    st.averageTerms(out);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cout << "usage: test_TriangleBZone.out path" << std::endl;
+    }
+    std::cout << "Starting TriangleBZone test." << std::endl;
+    const std::string& cfgFileName = "test_cfg",
+                       path = argv[1];
+    ConfigData *cfg = new ConfigData(path, cfgFileName);
+
+    // linear f averages to its corner mean, in any order and when flat
+    const double e[3] = {0.3, -0.2, 0.7}, flat[3] = {0.1, 0.1, 0.1},
+                 f[3] = {1.0, 2.0, 6.0};
+    double mean, flatMean;
+    TriangleBZone::integrate(e, f, 1, &mean, unit, unitMoments, 0.0, 0.0);
+    TriangleBZone::integrate(flat, f, 1, &flatMean, unit, unitMoments, 0.0, 
+                             0.0);
+    assert(fabs(mean - 3.0) < 1e-14);
+    assert(fabs(flatMean - 3.0) < 1e-14);
+
+    // a step at e = 0 gives the occupied fraction: e ranges over [-1, 1] 
+    // and the middle corner is at 0.5, so 1/3 of the triangle has e < 0
+    const double step[3] = {1.0, -1.0, 0.5}, ones[3] = {1.0, 1.0, 1.0};
+    double occupied;
+    TriangleBZone::integrate(step, ones, 1, &occupied, 
+        ZeroTempSpectrum::occupation, ZeroTempSpectrum::occupationMoments,
+        0.0, 0.0);
+    assert(fabs(occupied - 1.0 / 3.0) < 1e-14);
+    std::cout << "occupied = " << occupied << std::endl;
+
+    // with a tiny gap the occupations jump at the Fermi surface and the 
+    // gap equation's sum is nearly singular there: triangles on a 64 grid 
+    // should beat the plain sum on a 256 grid
+    cfg->setValue("initMu", 0.5);
+    cfg->setValue("initF0", 0.001);
+    double reference[3], triangle[3], grid[3];
+    terms(cfg, "triangle", 1024, 4, reference);
+    terms(cfg, "triangle", 64, 1, triangle);
+    terms(cfg, "grid", 256, 1, grid);
+    for (int i = 0; i < 3; i++) {
+        std::cout << "term " << i << ": reference = " << reference[i] 
+                  << " triangle error = " << triangle[i] - reference[i] 
+                  << " grid error = " << grid[i] - reference[i] 
+                  << std::endl;
+    }
+    assert(fabs(triangle[2] - reference[2]) 
+           < 0.1 * fabs(grid[2] - reference[2]));
+
+    // results must come out the same no matter how many threads are used
+    double threaded[3];
+    terms(cfg, "triangle", 64, 4, threaded);
+    for (int i = 0; i < 3; i++) {
+        assert(threaded[i] == triangle[i]);
+    }
+
+
+    // summing half the zone and doubling it changes only rounding
+    double full[3];
+    cfg->setValue("bzoneSymmetry", std::string("full"));
+    terms(cfg, "triangle", 64, 1, full);
+    for (int i = 0; i < 3; i++) {
+        assert(fabs(full[i] - triangle[i]) < 1e-12 * fabs(triangle[i]));
+    }
+
+    return 0;
+}
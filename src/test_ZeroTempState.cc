@@ -21,21 +21,39 @@
 */
 
 #include <iostream>
+#include <cmath>
+#include <cassert>
+
+#include <gsl/gsl_errno.h>
 
 #include "ConfigData.hh"
 #include "ZeroTempEnvironment.hh"
 #include "ZeroTempState.hh"
 
+// Runs the coupled solve alone, so a fallback to the nested one can't hide
+// its failure.
+class CoupledZeroTempState : public ZeroTempState {
+public:
+    CoupledZeroTempState(const ZeroTempEnvironment& envIn) : 
+        ZeroTempState(envIn) { }
+    bool solveCoupled() {
+        return fixCoupled() && checkSelfConsistent();
+    }
+};
+
 int main(int argc, char *argv[]) {
     if (argc < 2) {
         std::cout << "usage: test_State.out path" << std::endl;
     }
+    // as mainController does
+    gsl_set_error_handler_off();
     const std::string& cfgFileName = "test_cfg",
                        path = argv[1];
     ConfigData *cfg = new ConfigData(path, cfgFileName);
     ZeroTempEnvironment *env = new ZeroTempEnvironment(*cfg);
     ZeroTempState st(*env);
-    st.makeSelfConsistent();
+    bool success = st.makeSelfConsistent();
+    assert(success);
     std::cout << "D1: " << st.getD1() << " error: " 
         << st.absErrorD1() << std::endl;
     std::cout << "mu: " << st.getMu() << " error: " 
@@ -43,4 +61,38 @@ int main(int argc, char *argv[]) {
     std::cout << "F0: " << st.getF0() << " error: " 
          <<st.absErrorF0() << std::endl;
     std::cout << st.getEpsilonMin() << std::endl;
+
+    // the coupled solver finds the same solution as the nested one
+    CoupledZeroTempState stCoupled(*env);
+    success = stCoupled.solveCoupled();
+    assert(success);
+    std::cout << "coupled D1: " << stCoupled.getD1() << " mu: " 
+              << stCoupled.getMu() << " F0: " << stCoupled.getF0() 
+              << std::endl;
+    assert(fabs(stCoupled.getD1() - st.getD1()) < env->tolD1);
+    assert(fabs(stCoupled.getMu() - st.getMu()) < env->tolMu);
+    assert(fabs(stCoupled.getF0() - st.getF0()) < env->tolF0);
+
+    // coarse-to-fine levels and coarse bracket scans get the same solution
+    // as the single-level solve
+    cfg->setValue("multigridLevels", 3);
+    ZeroTempEnvironment *envLevels = new ZeroTempEnvironment(*cfg);
+    ZeroTempState stLevels(*envLevels);
+    success = stLevels.makeSelfConsistent();
+    assert(success);
+    cfg->setValue("multigridLevels", 1);
+    cfg->setValue("bracketGridLen", env->gridLen / 4);
+    ZeroTempEnvironment *envBracket = new ZeroTempEnvironment(*cfg);
+    ZeroTempState stBracket(*envBracket);
+    success = stBracket.makeSelfConsistent();
+    assert(success);
+    const ZeroTempState *others[2] = {&stLevels, &stBracket};
+    for (int i = 0; i < 2; i++) {
+        std::cout << (i == 0 ? "multigrid" : "coarse bracket") << " D1: " 
+                  << others[i]->getD1() << " mu: " << others[i]->getMu() 
+                  << std::endl;
+        assert(fabs(others[i]->getD1() - st.getD1()) < env->tolD1);
+        assert(fabs(others[i]->getMu() - st.getMu()) < env->tolMu);
+    }
+    return 0;
 }